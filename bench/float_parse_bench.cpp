@@ -0,0 +1,167 @@
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "textio.h"
+
+// Compares textio::stor with the digit accumulating parser it replaced,
+// on the real number tokens of a PLY file (test/data/test.ply by default).
+
+namespace
+{
+	// The former textio::stor, kept as the baseline.
+	template<typename T>
+	T legacyStor(const textio::SubString& substr)
+	{
+		auto p = substr.begin();
+		auto end = substr.end();
+		T real = 0.0;
+		bool negative = false;
+		if (p != end && *p == '-')
+		{
+			negative = true;
+			++p;
+		}
+		while (p != end && *p >= '0' && *p <= '9')
+		{
+			real = (real*static_cast<T>(10.0)) + (*p - '0');
+			++p;
+		}
+		if (p != end && *p == '.')
+		{
+			T frac = 0.0;
+			int n = 0;
+			++p;
+			while (p != end && *p >= '0' && *p <= '9')
+			{
+				frac = (frac*static_cast<T>(10.0)) + (*p - '0');
+				++p;
+				++n;
+			}
+			real += frac / std::pow(static_cast<T>(10.0), n);
+		}
+		if (p != end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			T sign = 1.0;
+			if (p != end && *p == '-')
+			{
+				sign = -1.0;
+				++p;
+			}
+			T exponent = 0.0;
+			while (p != end && *p >= '0' && *p <= '9')
+			{
+				exponent = (exponent*static_cast<T>(10.0)) + (*p - '0');
+				++p;
+			}
+			real = real * std::pow(static_cast<T>(10.0), sign * exponent);
+		}
+		if (negative)
+		{
+			real = -real;
+		}
+		return real;
+	}
+
+	// Real number tokens of the file body, i.e. tokens containing a '.' or an exponent.
+	std::vector<std::string> loadTokens(const std::string& filename)
+	{
+		std::ifstream file(filename);
+		std::vector<std::string> tokens;
+		std::string line;
+		bool body = false;
+		while (std::getline(file, line))
+		{
+			if (!body)
+			{
+				body = line == "end_header";
+				continue;
+			}
+			std::istringstream ss(line);
+			std::string token;
+			while (ss >> token)
+			{
+				if (token.find_first_of(".eE") != std::string::npos)
+				{
+					tokens.push_back(token);
+				}
+			}
+		}
+		return tokens;
+	}
+
+	template<typename T>
+	void run(const char* name, const std::vector<textio::SubString>& tokens, std::size_t bytes, int repeat, T(*parse)(const textio::SubString&))
+	{
+		T sum = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeat; ++r)
+		{
+			for (const auto& token : tokens)
+			{
+				sum += parse(token);
+			}
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		const double count = static_cast<double>(tokens.size()) * repeat;
+		std::cout << name << ": " << elapsed.count() * 1.0e9 / count << " ns/token, "
+			<< bytes * static_cast<double>(repeat) / elapsed.count() / 1.0e6 << " MB/s"
+			<< " (checksum " << sum << ")" << std::endl;
+	}
+
+	template<typename T>
+	std::size_t countInexact(const std::vector<textio::SubString>& tokens, T(*parse)(const textio::SubString&))
+	{
+		std::size_t inexact = 0;
+		for (const auto& token : tokens)
+		{
+			const std::string str = token;
+			const T expected = sizeof(T) == sizeof(float) ? static_cast<T>(std::strtof(str.c_str(), nullptr)) : static_cast<T>(std::strtod(str.c_str(), nullptr));
+			const T value = parse(token);
+			if (std::memcmp(&value, &expected, sizeof(T)) != 0)
+			{
+				++inexact;
+			}
+		}
+		return inexact;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string filename = argc > 1 ? argv[1] : "../test/data/test.ply";
+	const int repeat = argc > 2 ? std::atoi(argv[2]) : 50;
+
+	const std::vector<std::string> strings = loadTokens(filename);
+	if (strings.empty())
+	{
+		std::cerr << "No real number tokens in " << filename << std::endl;
+		return 1;
+	}
+	std::vector<textio::SubString> tokens;
+	std::size_t bytes = 0;
+	for (const auto& s : strings)
+	{
+		tokens.emplace_back(s);
+		bytes += s.size();
+	}
+
+	std::cout << tokens.size() << " tokens x " << repeat << std::endl;
+	run<float>("legacy float", tokens, bytes, repeat, legacyStor<float>);
+	run<float>("stor float", tokens, bytes, repeat, textio::stor<float>);
+	run<double>("legacy double", tokens, bytes, repeat, legacyStor<double>);
+	run<double>("stor double", tokens, bytes, repeat, textio::stor<double>);
+	run<double>("strtod", tokens, bytes, repeat, [](const textio::SubString& token) { return std::strtod(std::string(token).c_str(), nullptr); });
+
+	std::cout << "not correctly rounded: legacy float " << countInexact<float>(tokens, legacyStor<float>)
+		<< ", stor float " << countInexact<float>(tokens, textio::stor<float>)
+		<< ", legacy double " << countInexact<double>(tokens, legacyStor<double>)
+		<< ", stor double " << countInexact<double>(tokens, textio::stor<double>) << std::endl;
+}
@@ -0,0 +1,537 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libplyxx.h"
+#include "fileio.h"
+
+// End-to-end throughput of reading and writing synthetic PLY files, one JSON object per measurement on stdout.
+// The files are generated deterministically (no input data is needed) in the output directory and removed afterwards.
+// Reads follow the writes, so they run from the page cache unless the file is larger than the memory.
+//
+// Usage: libplyxx_bench [--dataset points|mesh|all] [--format ascii|le|be|all] [--size MB] [--elements N]
+//                       [--properties N] [--uchar-properties N] [--repeat N] [--threads N] [--memory MB] [--dir path] [--keep]
+
+namespace
+{
+	struct Options
+	{
+		std::string dataset = "all";
+		std::string format = "all";
+		double sizeMB = 64.0;
+		// Vertex count, overrides sizeMB when non zero.
+		std::size_t elements = 0;
+		std::size_t floatProperties = 3;
+		std::size_t ucharProperties = 0;
+		int repeat = 3;
+		unsigned int threads = std::max(2u, std::thread::hardware_concurrency());
+		// Paths holding the whole data in memory are skipped above this size.
+		double memoryMB = 1024.0;
+		std::string dir = ".";
+		bool keep = false;
+	};
+
+	std::uint64_t mix(std::uint64_t x)
+	{
+		// splitmix64 finalizer.
+		x += 0x9e3779b97f4a7c15ULL;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+
+	// Deterministic synthetic data: vertices with float then uchar properties,
+	// and for meshes the two triangles of each cell of a width x height vertex grid.
+	class Dataset
+	{
+	public:
+		Dataset(bool mesh, std::size_t vertexCount, std::size_t floatProperties, std::size_t ucharProperties)
+			: m_mesh(mesh), m_floatProperties(floatProperties), m_ucharProperties(ucharProperties)
+		{
+			if (mesh)
+			{
+				m_width = std::max<std::size_t>(2, static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(vertexCount)))));
+				m_height = std::max<std::size_t>(2, (vertexCount + m_width - 1) / m_width);
+				m_vertexCount = m_width * m_height;
+				m_faceCount = 2 * (m_width - 1) * (m_height - 1);
+			}
+			else
+			{
+				m_width = m_height = 0;
+				m_vertexCount = vertexCount;
+				m_faceCount = 0;
+			}
+		}
+
+		const char* name() const { return m_mesh ? "mesh" : "points"; };
+		std::size_t vertexCount() const { return m_vertexCount; };
+		std::size_t faceCount() const { return m_faceCount; };
+		std::size_t elementCount() const { return m_vertexCount + m_faceCount; };
+		std::size_t floatProperties() const { return m_floatProperties; };
+		std::size_t ucharProperties() const { return m_ucharProperties; };
+
+		libply::ElementsDefinition definitions() const
+		{
+			static const char* const AXES[] = { "x", "y", "z" };
+			std::vector<libply::Property> properties;
+			for (std::size_t p = 0; p < m_floatProperties; ++p)
+			{
+				properties.emplace_back(p < 3 ? std::string(AXES[p]) : "f" + std::to_string(p), libply::Type::FLOAT, false);
+			}
+			for (std::size_t p = 0; p < m_ucharProperties; ++p)
+			{
+				properties.emplace_back("u" + std::to_string(p), libply::Type::UCHAR, false);
+			}
+			libply::ElementsDefinition definitions = { libply::Element("vertex", m_vertexCount, properties) };
+			if (m_mesh)
+			{
+				definitions.emplace_back("face", m_faceCount, std::vector<libply::Property>{ libply::Property("vertex_indices", libply::Type::INT, true) });
+			}
+			return definitions;
+		}
+
+		float floatValue(std::size_t vertex, std::size_t property) const
+		{
+			// 24 random bits in [-100, 100).
+			const std::uint64_t h = mix(vertex * 64 + property);
+			return static_cast<float>(h >> 40) * (200.0f / 16777216.0f) - 100.0f;
+		}
+
+		unsigned char ucharValue(std::size_t vertex, std::size_t property) const
+		{
+			return static_cast<unsigned char>(mix(vertex * 64 + 32 + property));
+		}
+
+		void face(std::size_t index, int* indices) const
+		{
+			const std::size_t cell = index / 2;
+			const std::size_t v = (cell / (m_width - 1)) * m_width + cell % (m_width - 1);
+			if (index % 2 == 0)
+			{
+				indices[0] = static_cast<int>(v);
+				indices[1] = static_cast<int>(v + 1);
+				indices[2] = static_cast<int>(v + m_width);
+			}
+			else
+			{
+				indices[0] = static_cast<int>(v + 1);
+				indices[1] = static_cast<int>(v + m_width + 1);
+				indices[2] = static_cast<int>(v + m_width);
+			}
+		}
+
+		// Sum of the bits of the first float property and of the face indices, independent of the delivery order.
+		std::uint64_t checksum() const
+		{
+			std::uint64_t sum = 0;
+			for (std::size_t v = 0; m_floatProperties != 0 && v < m_vertexCount; ++v)
+			{
+				sum += floatBits(floatValue(v, 0));
+			}
+			for (std::size_t f = 0; f < m_faceCount; ++f)
+			{
+				int indices[3];
+				face(f, indices);
+				sum += static_cast<std::uint64_t>(indices[0]) + indices[1] + indices[2];
+			}
+			return sum;
+		}
+
+		// Size of the data in memory, as arrays.
+		double memoryBytes() const
+		{
+			return static_cast<double>(m_vertexCount) * (4 * m_floatProperties + m_ucharProperties) + static_cast<double>(m_faceCount) * 16;
+		}
+
+		static std::uint64_t floatBits(float value)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+	private:
+		bool m_mesh;
+		std::size_t m_floatProperties;
+		std::size_t m_ucharProperties;
+		std::size_t m_width;
+		std::size_t m_height;
+		std::size_t m_vertexCount;
+		std::size_t m_faceCount;
+	};
+
+	// The data of a dataset, as the arrays FileOut writes and batch reads fill.
+	struct Arrays
+	{
+		std::vector<std::vector<float>> floats;
+		std::vector<std::vector<unsigned char>> uchars;
+		std::vector<unsigned int> faceOffsets;
+		std::vector<int> faceIndices;
+
+		explicit Arrays(const Dataset& dataset)
+			: floats(dataset.floatProperties(), std::vector<float>(dataset.vertexCount())),
+			uchars(dataset.ucharProperties(), std::vector<unsigned char>(dataset.vertexCount())),
+			faceOffsets(dataset.faceCount() + 1), faceIndices(3 * dataset.faceCount())
+		{
+			for (std::size_t f = 0; f <= dataset.faceCount(); ++f)
+			{
+				faceOffsets[f] = static_cast<unsigned int>(3 * f);
+			}
+		}
+
+		void generate(const Dataset& dataset)
+		{
+			for (std::size_t v = 0; v < dataset.vertexCount(); ++v)
+			{
+				for (std::size_t p = 0; p < floats.size(); ++p)
+				{
+					floats[p][v] = dataset.floatValue(v, p);
+				}
+				for (std::size_t p = 0; p < uchars.size(); ++p)
+				{
+					uchars[p][v] = dataset.ucharValue(v, p);
+				}
+			}
+			for (std::size_t f = 0; f < dataset.faceCount(); ++f)
+			{
+				dataset.face(f, &faceIndices[3 * f]);
+			}
+		}
+
+		void setArrays(libply::FileOut& file) const
+		{
+			libply::ElementArrays vertexArrays;
+			for (const auto& column : floats)
+			{
+				vertexArrays.push_back(libply::propertyArray(column.data()));
+			}
+			for (const auto& column : uchars)
+			{
+				vertexArrays.push_back(libply::propertyArray(column.data()));
+			}
+			file.setElementArrays("vertex", vertexArrays);
+			if (!faceIndices.empty())
+			{
+				file.setElementArrays("face", { libply::listArray(faceOffsets.data(), faceIndices.data()) });
+			}
+		}
+	};
+
+	PATH_STRING toPath(const std::string& path)
+	{
+		return PATH_STRING(path.begin(), path.end());
+	}
+
+	std::uint64_t fileSize(const std::string& path)
+	{
+		fileio::FileStatus status;
+		return fileio::fileStatus(path, status) ? status.size : 0;
+	}
+
+	void writeCallbacks(const Dataset& dataset, const std::string& path, libply::File::Format format)
+	{
+		libply::FileOut file(toPath(path), format);
+		file.setElementsDefinition(dataset.definitions());
+		libply::ElementWriteCallback vertexCallback = [&dataset](libply::ElementBuffer& e, std::size_t index)
+		{
+			std::size_t k = 0;
+			for (std::size_t p = 0; p < dataset.floatProperties(); ++p)
+			{
+				e.set<float>(k++, dataset.floatValue(index, p));
+			}
+			for (std::size_t p = 0; p < dataset.ucharProperties(); ++p)
+			{
+				e.set<unsigned int>(k++, dataset.ucharValue(index, p));
+			}
+		};
+		libply::ElementWriteCallback faceCallback = [&dataset](libply::ElementBuffer& e, std::size_t index)
+		{
+			int indices[3];
+			dataset.face(index, indices);
+			e.reset(3);
+			for (std::size_t k = 0; k < 3; ++k)
+			{
+				e.set<int>(k, indices[k]);
+			}
+		};
+		file.setElementWriteCallback("vertex", vertexCallback);
+		if (dataset.faceCount() != 0)
+		{
+			file.setElementWriteCallback("face", faceCallback);
+		}
+		file.write();
+	}
+
+	void writeArrays(const Dataset& dataset, const Arrays& arrays, const std::string& path, libply::File::Format format)
+	{
+		libply::FileOut file(toPath(path), format);
+		file.setElementsDefinition(dataset.definitions());
+		arrays.setArrays(file);
+		file.write();
+	}
+
+	enum class ReadPath { ELEMENT, BATCH, PARALLEL, READ_AHEAD };
+
+	std::uint64_t readFile(const std::string& path, ReadPath readPath, unsigned int threads)
+	{
+		libply::File file(toPath(path));
+		std::uint64_t sum = 0;
+		libply::ElementReadCallback vertexCallback = [&sum](libply::ElementBuffer& e)
+		{
+			sum += Dataset::floatBits(e.get<float>(0));
+		};
+		libply::ElementReadCallback faceCallback = [&sum](libply::ElementBuffer& e)
+		{
+			for (std::size_t k = 0; k < e.size(); ++k)
+			{
+				sum += static_cast<std::uint64_t>(e.get<int>(k));
+			}
+		};
+		libply::ElementBatchReadCallback vertexBatchCallback = [&sum](libply::ElementBatch& b)
+		{
+			for (const float value : b.column<float>(0))
+			{
+				sum += Dataset::floatBits(value);
+			}
+		};
+		libply::ElementBatchReadCallback faceBatchCallback = [&sum](libply::ElementBatch& b)
+		{
+			for (const int index : b.column<int>(0))
+			{
+				sum += static_cast<std::uint64_t>(index);
+			}
+		};
+
+		const bool mesh = file.definitions().size() > 1;
+		if (readPath == ReadPath::ELEMENT)
+		{
+			file.setElementReadCallback("vertex", vertexCallback);
+			if (mesh) file.setElementReadCallback("face", faceCallback);
+		}
+		else
+		{
+			file.setElementBatchReadCallback("vertex", vertexBatchCallback);
+			if (mesh) file.setElementBatchReadCallback("face", faceBatchCallback);
+		}
+		if (readPath == ReadPath::PARALLEL)
+		{
+			file.setThreadCount(threads);
+		}
+		if (readPath == ReadPath::READ_AHEAD)
+		{
+			file.setReadAhead();
+		}
+		file.read();
+		return sum;
+	}
+
+	// Load the whole file into arrays, as an application would before modifying and saving it.
+	void readArrays(const std::string& path, Arrays& arrays)
+	{
+		libply::File file(toPath(path));
+		libply::ElementBatchReadCallback vertexCallback = [&arrays](libply::ElementBatch& b)
+		{
+			std::size_t c = 0;
+			for (auto& column : arrays.floats)
+			{
+				const auto values = b.column<float>(c++);
+				std::copy(values.begin(), values.end(), column.begin() + b.firstIndex());
+			}
+			for (auto& column : arrays.uchars)
+			{
+				const auto values = b.column<unsigned char>(c++);
+				std::copy(values.begin(), values.end(), column.begin() + b.firstIndex());
+			}
+		};
+		libply::ElementBatchReadCallback faceCallback = [&arrays](libply::ElementBatch& b)
+		{
+			const auto values = b.column<int>(0);
+			const auto offsets = b.listOffsets();
+			std::copy(values.begin(), values.end(), arrays.faceIndices.begin() + 3 * b.firstIndex());
+			for (std::size_t i = 0; i <= b.size(); ++i)
+			{
+				arrays.faceOffsets[b.firstIndex() + i] = static_cast<unsigned int>(3 * b.firstIndex() + offsets[i]);
+			}
+		};
+		file.setElementBatchReadCallback("vertex", vertexCallback);
+		if (!arrays.faceIndices.empty())
+		{
+			file.setElementBatchReadCallback("face", faceCallback);
+		}
+		file.read();
+	}
+
+	template<typename Run>
+	double bestTime(int repeat, const Run& run)
+	{
+		double best = 0.0;
+		for (int r = 0; r < repeat; ++r)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			run();
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			best = r == 0 ? elapsed.count() : std::min(best, elapsed.count());
+		}
+		return best;
+	}
+
+	void report(const Dataset& dataset, const char* format, const char* operation, const char* path,
+		std::uint64_t bytes, double seconds, bool valid)
+	{
+		std::ostringstream line;
+		line << "{\"dataset\":\"" << dataset.name() << "\",\"format\":\"" << format
+			<< "\",\"operation\":\"" << operation << "\",\"path\":\"" << path
+			<< "\",\"float_properties\":" << dataset.floatProperties()
+			<< ",\"uchar_properties\":" << dataset.ucharProperties()
+			<< ",\"elements\":" << dataset.elementCount() << ",\"bytes\":" << bytes
+			<< ",\"seconds\":" << seconds
+			<< ",\"mb_per_s\":" << bytes / seconds / 1.0e6
+			<< ",\"elements_per_s\":" << dataset.elementCount() / seconds
+			<< ",\"valid\":" << (valid ? "true" : "false") << "}";
+		std::cout << line.str() << std::endl;
+	}
+
+	// Approximate file size of one vertex (with its faces for meshes), to size the datasets.
+	double bytesPerVertex(const Options& options, bool mesh, libply::File::Format format)
+	{
+		const bool ascii = format == libply::File::Format::ASCII;
+		const double vertex = options.floatProperties * (ascii ? 11.0 : 4.0) + options.ucharProperties * (ascii ? 4.0 : 1.0);
+		const double face = ascii ? 24.0 : 13.0;
+		return vertex + (mesh ? 2 * face : 0.0);
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			if (arg == "--keep")
+			{
+				options.keep = true;
+				continue;
+			}
+			if (i + 1 == argc)
+			{
+				return false;
+			}
+			const std::string value = argv[++i];
+			if (arg == "--dataset") options.dataset = value;
+			else if (arg == "--format") options.format = value;
+			else if (arg == "--size") options.sizeMB = std::atof(value.c_str());
+			else if (arg == "--elements") options.elements = std::strtoull(value.c_str(), nullptr, 10);
+			else if (arg == "--properties") options.floatProperties = std::strtoull(value.c_str(), nullptr, 10);
+			else if (arg == "--uchar-properties") options.ucharProperties = std::strtoull(value.c_str(), nullptr, 10);
+			else if (arg == "--repeat") options.repeat = std::max(1, std::atoi(value.c_str()));
+			else if (arg == "--threads") options.threads = static_cast<unsigned int>(std::max(1, std::atoi(value.c_str())));
+			else if (arg == "--memory") options.memoryMB = std::atof(value.c_str());
+			else if (arg == "--dir") options.dir = value;
+			else return false;
+		}
+		return options.floatProperties != 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		std::cerr << "Usage: libplyxx_bench [--dataset points|mesh|all] [--format ascii|le|be|all] [--size MB] [--elements N]\n"
+			"  [--properties N] [--uchar-properties N] [--repeat N] [--threads N] [--memory MB] [--dir path] [--keep]\n"
+			"At least one float property is required." << std::endl;
+		return 2;
+	}
+
+	struct FormatEntry
+	{
+		const char* name;
+		libply::File::Format format;
+	};
+	const FormatEntry FORMATS[] =
+	{
+		{ "ascii", libply::File::Format::ASCII },
+		{ "le", libply::File::Format::BINARY_LITTLE_ENDIAN },
+		{ "be", libply::File::Format::BINARY_BIG_ENDIAN },
+	};
+
+	bool allValid = true;
+	for (const bool mesh : { false, true })
+	{
+		if (options.dataset != "all" && options.dataset != (mesh ? "mesh" : "points"))
+		{
+			continue;
+		}
+		for (const auto& entry : FORMATS)
+		{
+			if (options.format != "all" && options.format != entry.name)
+			{
+				continue;
+			}
+			const std::size_t vertexCount = options.elements != 0 ? options.elements
+				: std::max<std::size_t>(4, static_cast<std::size_t>(options.sizeMB * 1.0e6 / bytesPerVertex(options, mesh, entry.format)));
+			const Dataset dataset(mesh, vertexCount, options.floatProperties, options.ucharProperties);
+			const std::uint64_t expected = dataset.checksum();
+			const std::string path = options.dir + "/libplyxx_bench_" + dataset.name() + "_" + entry.name + ".ply";
+			const std::string copyPath = options.dir + "/libplyxx_bench_" + dataset.name() + "_" + entry.name + "_copy.ply";
+			const bool inMemory = dataset.memoryBytes() <= options.memoryMB * 1.0e6;
+
+			// Writes.
+			double seconds = bestTime(options.repeat, [&]() { writeCallbacks(dataset, path, entry.format); });
+			const std::uint64_t bytes = fileSize(path);
+			report(dataset, entry.name, "write", "callback", bytes, seconds, true);
+			if (inMemory)
+			{
+				Arrays arrays(dataset);
+				arrays.generate(dataset);
+				seconds = bestTime(options.repeat, [&]() { writeArrays(dataset, arrays, copyPath, entry.format); });
+				report(dataset, entry.name, "write", "arrays", fileSize(copyPath), seconds, true);
+			}
+
+			// Reads.
+			const struct { const char* name; ReadPath path; } READ_PATHS[] =
+			{
+				{ "element", ReadPath::ELEMENT },
+				{ "batch", ReadPath::BATCH },
+				{ "parallel", ReadPath::PARALLEL },
+				{ "readahead", ReadPath::READ_AHEAD },
+			};
+			for (const auto& readPath : READ_PATHS)
+			{
+				std::uint64_t sum = 0;
+				seconds = bestTime(options.repeat, [&]() { sum = readFile(path, readPath.path, options.threads); });
+				allValid = allValid && sum == expected;
+				report(dataset, entry.name, "read", readPath.name, bytes, seconds, sum == expected);
+			}
+
+			// Round trip: load into arrays and save again.
+			if (inMemory)
+			{
+				Arrays arrays(dataset);
+				seconds = bestTime(options.repeat, [&]()
+				{
+					readArrays(path, arrays);
+					writeArrays(dataset, arrays, copyPath, entry.format);
+				});
+				const bool valid = readFile(copyPath, ReadPath::BATCH, 1) == expected;
+				allValid = allValid && valid;
+				report(dataset, entry.name, "roundtrip", "batch_arrays", bytes + fileSize(copyPath), seconds, valid);
+			}
+
+			if (!options.keep)
+			{
+				std::remove(path.c_str());
+				std::remove(copyPath.c_str());
+			}
+		}
+	}
+	return allValid ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "libplyxx_internal.h"
+
+// Compares the ASCII chunk decoder with the token based parsing it replaced,
+// on the elements of an ASCII PLY file (test/data/test.ply by default) with every section repeated scale times.
+
+namespace
+{
+	// The former per-token conversions, called through a function pointer per value.
+	typedef void(*ParseFunction)(const textio::SubString&, char*);
+
+	template<typename T>
+	void parseSigned(const textio::SubString& token, char* dest)
+	{
+		const T value = textio::stoi<T>(token);
+		std::memcpy(dest, &value, sizeof(T));
+	}
+
+	template<typename T>
+	void parseUnsigned(const textio::SubString& token, char* dest)
+	{
+		const T value = textio::stou<T>(token);
+		std::memcpy(dest, &value, sizeof(T));
+	}
+
+	template<typename T>
+	void parseReal(const textio::SubString& token, char* dest)
+	{
+		const T value = textio::stor<T>(token);
+		std::memcpy(dest, &value, sizeof(T));
+	}
+
+	ParseFunction parseFunction(libply::Type type)
+	{
+		switch (type)
+		{
+		case libply::Type::CHAR: return parseSigned<signed char>;
+		case libply::Type::UCHAR: return parseUnsigned<unsigned char>;
+		case libply::Type::SHORT: return parseSigned<short>;
+		case libply::Type::USHORT: return parseUnsigned<unsigned short>;
+		case libply::Type::INT: return parseSigned<int>;
+		case libply::Type::UINT: return parseUnsigned<unsigned int>;
+		case libply::Type::FLOAT: return parseReal<float>;
+		case libply::Type::DOUBLE: return parseReal<double>;
+		}
+		return nullptr;
+	}
+
+	// Decoded values of one element section, one column per property (a single one for lists).
+	struct Columns
+	{
+		std::vector<std::vector<char>> values;
+		std::vector<std::size_t> listOffsets;
+	};
+
+	Columns makeColumns(const libply::ElementDefinition& definition)
+	{
+		Columns columns;
+		for (const auto& p : definition.properties)
+		{
+			columns.values.emplace_back(p.isList ? 0 : definition.size * p.typeSize);
+		}
+		columns.listOffsets.push_back(0);
+		return columns;
+	}
+
+	// The former parseLine(), storing the tokens of a line through the parse function of each property.
+	void parseTokens(const textio::Tokenizer::TokenList& tokens, const libply::ElementDefinition& definition,
+		const std::vector<ParseFunction>& functions, std::size_t index, Columns& columns)
+	{
+		const auto& properties = definition.properties;
+		if (!properties.front().isList)
+		{
+			for (std::size_t i = 0; i < properties.size(); ++i)
+			{
+				functions[i](tokens[i], columns.values[i].data() + index * properties[i].typeSize);
+			}
+			return;
+		}
+		const std::size_t typeSize = properties.front().typeSize;
+		const std::size_t length = std::stoi(tokens[0]);
+		auto& values = columns.values.front();
+		const std::size_t begin = columns.listOffsets.back();
+		values.resize((begin + length) * typeSize);
+		for (std::size_t i = 0; i < length; ++i)
+		{
+			functions[0](tokens[i + 1], values.data() + (begin + i) * typeSize);
+		}
+		columns.listOffsets.push_back(begin + length);
+	}
+
+	std::vector<ParseFunction> parseFunctions(const libply::ElementDefinition& definition)
+	{
+		std::vector<ParseFunction> functions;
+		for (const auto& p : definition.properties)
+		{
+			functions.push_back(parseFunction(p.type));
+		}
+		return functions;
+	}
+
+	// Lines split with the Tokenizer one at a time.
+	Columns decodeTokenizer(const std::string& text, const libply::ElementDefinition& definition)
+	{
+		Columns columns = makeColumns(definition);
+		const auto functions = parseFunctions(definition);
+		textio::Tokenizer tokenizer(' ');
+		textio::Tokenizer::TokenList tokens;
+		const char* p = text.data();
+		const char* end = p + text.size();
+		for (std::size_t index = 0; p < end; ++index)
+		{
+			const char* eol = std::find(p, end, '\n');
+			tokens.clear();
+			tokenizer.tokenize(textio::SubString(p, eol), tokens);
+			parseTokens(tokens, definition, functions, index, columns);
+			p = eol + 1;
+		}
+		return columns;
+	}
+
+	bool sameValues(const Columns& columns, const libply::ElementBatch& batch)
+	{
+		const auto offsets = batch.listOffsets();
+		if (batch.isList() && !std::equal(offsets.begin(), offsets.end(), columns.listOffsets.begin(), columns.listOffsets.end()))
+		{
+			return false;
+		}
+		for (std::size_t i = 0; i < batch.propertyCount(); ++i)
+		{
+			const auto& values = columns.values[i];
+			const std::size_t count = batch.isList() ? batch.listOffsets()[batch.size()] : batch.size();
+			if (count * batch.typeSize(i) != values.size() || std::memcmp(values.data(), batch.columnData(i), values.size()) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template<typename Decode>
+	double bestTime(int repeat, const Decode& decode)
+	{
+		double best = 0.0;
+		for (int r = 0; r < repeat; ++r)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			decode();
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			best = r == 0 ? elapsed.count() : std::min(best, elapsed.count());
+		}
+		return best;
+	}
+
+	void report(const std::string& element, const char* name, double seconds, std::size_t elements, std::size_t bytes)
+	{
+		std::cout << element << " " << name << ": " << seconds * 1.0e9 / elements << " ns/element, "
+			<< bytes / seconds / 1.0e6 << " MB/s" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const std::string filename = argc > 1 ? argv[1] : "../test/data/test.ply";
+	const std::size_t scale = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+	const int repeat = argc > 3 ? std::atoi(argv[3]) : 5;
+
+	std::vector<libply::Element> elements;
+	try
+	{
+		elements = libply::File(filename).definitions();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	std::ifstream input(filename, std::ios::binary);
+	std::string line;
+	while (std::getline(input, line) && line.compare(0, 10, "end_header") != 0)
+	{
+	}
+
+	for (const auto& element : elements)
+	{
+		// The lines of the section, repeated.
+		std::string section;
+		for (std::size_t i = 0; i < element.size && std::getline(input, line); ++i)
+		{
+			section += line;
+			section += '\n';
+		}
+		std::string text;
+		text.reserve(section.size() * scale);
+		for (std::size_t i = 0; i < scale; ++i)
+		{
+			text += section;
+		}
+
+		libply::ElementDefinition definition(element);
+		definition.size = element.size * scale;
+
+		Columns tokenized;
+		libply::ElementBatch batch;
+		const double tokenizerTime = bestTime(repeat, [&]() { tokenized = decodeTokenizer(text, definition); });
+		const double decoderTime = bestTime(repeat, [&]()
+		{
+			batch = libply::ElementBatch(definition, definition.size);
+			libply::TextDecoder decoder(definition);
+			decoder.decode(text.data(), text.data() + text.size(), definition.size, batch);
+		});
+
+		std::cout << element.name << ": " << definition.size << " elements, " << text.size() << " bytes x " << repeat << std::endl;
+		report(element.name, "tokenizer", tokenizerTime, definition.size, text.size());
+		report(element.name, "decoder", decoderTime, definition.size, text.size());
+		if (batch.size() != definition.size || !sameValues(tokenized, batch))
+		{
+			std::cerr << element.name << ": decoded values differ" << std::endl;
+			return 1;
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#include "byteswap.h"
+#include "cpu.h"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef LIBPLYXX_X86
+	#include <immintrin.h>
+#endif
+
+namespace libply
+{
+namespace
+{
+	template<typename T>
+	T swapValue(T value);
+
+	template<>
+	std::uint16_t swapValue(std::uint16_t value)
+	{
+		return static_cast<std::uint16_t>((value >> 8) | (value << 8));
+	}
+
+	template<>
+	std::uint32_t swapValue(std::uint32_t value)
+	{
+		return ((value & 0x000000ffu) << 24) | ((value & 0x0000ff00u) << 8)
+			| ((value & 0x00ff0000u) >> 8) | ((value & 0xff000000u) >> 24);
+	}
+
+	template<>
+	std::uint64_t swapValue(std::uint64_t value)
+	{
+		return (static_cast<std::uint64_t>(swapValue(static_cast<std::uint32_t>(value))) << 32)
+			| swapValue(static_cast<std::uint32_t>(value >> 32));
+	}
+
+	template<typename T>
+	void swapScalar(char* data, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			T value;
+			std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+			value = swapValue(value);
+			std::memcpy(data + i * sizeof(T), &value, sizeof(T));
+		}
+	}
+
+	void swapScalar(char* data, std::size_t count, std::size_t typeSize)
+	{
+		switch (typeSize)
+		{
+		case 2: swapScalar<std::uint16_t>(data, count); break;
+		case 4: swapScalar<std::uint32_t>(data, count); break;
+		case 8: swapScalar<std::uint64_t>(data, count); break;
+		}
+	}
+
+#ifdef LIBPLYXX_X86
+	// Byte indices reversing each 2, 4 or 8 byte value of a 16 byte lane.
+	const std::int8_t SWAP_MASKS[3][16] =
+	{
+		{ 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+		{ 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+		{ 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 },
+	};
+
+	const std::int8_t* swapMask(std::size_t typeSize)
+	{
+		return SWAP_MASKS[typeSize == 2 ? 0 : (typeSize == 4 ? 1 : 2)];
+	}
+
+	LIBPLYXX_TARGET("ssse3")
+	std::size_t swapSSSE3(char* data, std::size_t size, std::size_t typeSize)
+	{
+		const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swapMask(typeSize)));
+		std::size_t i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i* p = reinterpret_cast<__m128i*>(data + i);
+			_mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+		}
+		return i;
+	}
+
+	LIBPLYXX_TARGET("avx2")
+	std::size_t swapAVX2(char* data, std::size_t size, std::size_t typeSize)
+	{
+		// vpshufb shuffles within each 128 bit lane, the same mask is used for both.
+		const __m128i laneMask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(swapMask(typeSize)));
+		const __m256i mask = _mm256_broadcastsi128_si256(laneMask);
+		std::size_t i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			__m256i* p = reinterpret_cast<__m256i*>(data + i);
+			_mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+		}
+		return i;
+	}
+#endif
+}
+
+void swapByteOrder(char* data, std::size_t count, std::size_t typeSize)
+{
+	if (typeSize < 2)
+	{
+		return;
+	}
+	std::size_t swapped = 0;
+#ifdef LIBPLYXX_X86
+	// Vectors hold a whole number of values, the remainder is swapped one value at a time.
+	const std::size_t size = count * typeSize;
+	if (cpuFeatures().avx2)
+	{
+		swapped = swapAVX2(data, size, typeSize);
+	}
+	if (cpuFeatures().ssse3)
+	{
+		swapped += swapSSSE3(data + swapped, size - swapped, typeSize);
+	}
+#endif
+	swapScalar(data + swapped, count - swapped / typeSize, typeSize);
+}
+}
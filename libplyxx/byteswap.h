@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+namespace libply
+{
+	// Reverse the byte order of count consecutive values of typeSize bytes, in place.
+	// Whole blocks of values are swapped with SIMD shuffles when the CPU supports them.
+	void swapByteOrder(char* data, std::size_t count, std::size_t typeSize);
+}
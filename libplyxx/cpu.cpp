@@ -0,0 +1,40 @@
+#include "cpu.h"
+
+#if defined(LIBPLYXX_X86) && defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace libply
+{
+CpuFeatures detectCpuFeatures()
+{
+	CpuFeatures features{ false, false, false };
+#if defined(LIBPLYXX_X86) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	features.ssse3 = __builtin_cpu_supports("ssse3") != 0;
+	features.sse42 = __builtin_cpu_supports("sse4.2") != 0;
+	features.avx2 = __builtin_cpu_supports("avx2") != 0;
+#elif defined(LIBPLYXX_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	__cpuid(info, 1);
+	features.ssse3 = (info[2] & (1 << 9)) != 0;
+	features.sse42 = (info[2] & (1 << 20)) != 0;
+	// AVX2 also needs the OS to save the YMM registers.
+	const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+	if (maxLeaf >= 7 && osSavesYmm)
+	{
+		__cpuidex(info, 7, 0);
+		features.avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#endif
+	return features;
+}
+
+const CpuFeatures& cpuFeatures()
+{
+	static const CpuFeatures features = detectCpuFeatures();
+	return features;
+}
+}
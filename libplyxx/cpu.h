@@ -0,0 +1,25 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define LIBPLYXX_X86
+#endif
+
+// Compile a function for an instruction set extension that is selected at runtime.
+#if defined(LIBPLYXX_X86) && (defined(__GNUC__) || defined(__clang__))
+	#define LIBPLYXX_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define LIBPLYXX_TARGET(isa)
+#endif
+
+namespace libply
+{
+	// Instruction set extensions available on the running CPU.
+	struct CpuFeatures
+	{
+		bool ssse3;
+		bool sse42;
+		bool avx2;
+	};
+
+	const CpuFeatures& cpuFeatures();
+}
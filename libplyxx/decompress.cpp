@@ -0,0 +1,486 @@
+#include "decompress.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef LIBPLYXX_ZLIB
+	#include <zlib.h>
+#endif
+#ifdef LIBPLYXX_ZSTD
+	#include <zstd.h>
+#endif
+
+namespace fileio
+{
+namespace
+{
+	const std::size_t INPUT_CHUNK_SIZE = 1 << 20;
+
+	// Compressed bytes of a file, read by chunks and consumed from the front.
+	class CompressedInput
+	{
+	public:
+		template<typename PathString>
+		explicit CompressedInput(const PathString& filename)
+			: m_file(filename, std::ios::binary), m_data(INPUT_CHUNK_SIZE), m_begin(0), m_end(0)
+		{
+			if (!m_file.is_open())
+			{
+				throw std::runtime_error("Could not open file.");
+			}
+		}
+
+		const char* data() const { return m_data.data() + m_begin; };
+		std::size_t size() const { return m_end - m_begin; };
+		void consume(std::size_t count) { m_begin += count; };
+
+		// Append the next bytes of the file, with room for at least required bytes. False at the end of the file.
+		bool fill(std::size_t required)
+		{
+			const std::size_t available = size();
+			if (m_begin != 0)
+			{
+				std::memmove(m_data.data(), data(), available);
+				m_begin = 0;
+				m_end = available;
+			}
+			required = std::max(required, available + INPUT_CHUNK_SIZE);
+			if (m_data.size() < required)
+			{
+				m_data.resize(std::max(required, 2 * m_data.size()));
+			}
+			m_file.read(m_data.data() + m_end, m_data.size() - m_end);
+			if (m_file.bad())
+			{
+				throw std::runtime_error("Could not read file.");
+			}
+			const std::size_t count = static_cast<std::size_t>(m_file.gcount());
+			m_end += count;
+			return count != 0;
+		}
+
+		void rewind()
+		{
+			m_file.clear();
+			m_file.seekg(0);
+			if (!m_file)
+			{
+				throw std::runtime_error("Could not seek in file.");
+			}
+			m_begin = m_end = 0;
+		}
+
+	private:
+		std::ifstream m_file;
+		std::vector<char> m_data;
+		std::size_t m_begin;
+		std::size_t m_end;
+	};
+
+	template<typename PathString>
+	Compression detect(const PathString& filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		char magic[4] = {};
+		file.read(magic, sizeof(magic));
+		return detectCompression(magic, static_cast<std::size_t>(file.gcount()));
+	}
+
+#ifdef LIBPLYXX_ZLIB
+	class GzipStream : public InputStream
+	{
+	public:
+		template<typename PathString>
+		explicit GzipStream(const PathString& filename)
+			: m_input(filename), m_stream(), m_inMember(false), m_finished(false)
+		{
+			// 32 adds the detection of the gzip header to the largest window.
+			if (inflateInit2(&m_stream, 15 + 32) != Z_OK)
+			{
+				throw std::runtime_error("Could not initialize gzip decoder.");
+			}
+		}
+
+		~GzipStream() override
+		{
+			inflateEnd(&m_stream);
+		}
+
+		std::size_t read(char* data, std::size_t size) override
+		{
+			std::size_t produced = 0;
+			while (produced < size && !m_finished)
+			{
+				if (m_input.size() < 2 && !m_input.fill(0) && m_input.size() == 0)
+				{
+					if (m_inMember)
+					{
+						throw std::runtime_error("Unexpected end of compressed file.");
+					}
+					m_finished = true;
+					break;
+				}
+				if (!m_inMember)
+				{
+					// Anything but another member after the last one is ignored, as gzip does with padding.
+					const unsigned char* magic = reinterpret_cast<const unsigned char*>(m_input.data());
+					if (m_input.size() < 2 || magic[0] != 0x1f || magic[1] != 0x8b)
+					{
+						m_finished = true;
+						break;
+					}
+					m_inMember = true;
+				}
+
+				const uInt in = static_cast<uInt>(std::min<std::size_t>(m_input.size(), UINT_MAX));
+				const uInt out = static_cast<uInt>(std::min<std::size_t>(size - produced, UINT_MAX));
+				m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(m_input.data()));
+				m_stream.avail_in = in;
+				m_stream.next_out = reinterpret_cast<Bytef*>(data + produced);
+				m_stream.avail_out = out;
+				const int result = inflate(&m_stream, Z_NO_FLUSH);
+				m_input.consume(in - m_stream.avail_in);
+				produced += out - m_stream.avail_out;
+				if (result == Z_STREAM_END)
+				{
+					inflateReset(&m_stream);
+					m_inMember = false;
+				}
+				else if (result != Z_OK && result != Z_BUF_ERROR)
+				{
+					throw std::runtime_error("Invalid gzip data.");
+				}
+			}
+			return produced;
+		}
+
+		void rewind() override
+		{
+			m_input.rewind();
+			inflateReset(&m_stream);
+			m_inMember = false;
+			m_finished = false;
+		}
+
+	private:
+		CompressedInput m_input;
+		z_stream m_stream;
+		bool m_inMember;
+		bool m_finished;
+	};
+#endif
+
+#ifdef LIBPLYXX_ZSTD
+	// Frames decoded ahead on worker threads are bounded in size, larger or incomplete ones are streamed.
+	const std::size_t MAX_PARALLEL_FRAME_SIZE = 64 << 20;
+	const std::size_t MAX_PARALLEL_FRAME_INPUT = 16 << 20;
+
+	struct DecoderContext
+	{
+		DecoderContext() : context(ZSTD_createDCtx())
+		{
+			if (!context)
+			{
+				throw std::runtime_error("Could not initialize zstd decoder.");
+			}
+		}
+		DecoderContext(const DecoderContext& other) = delete;
+		DecoderContext& operator=(const DecoderContext& other) = delete;
+		~DecoderContext() { ZSTD_freeDCtx(context); }
+
+		ZSTD_DCtx* context;
+	};
+
+	// A whole frame, decoded into output.
+	void decodeFrame(const std::vector<char>& frame, std::vector<char>& output)
+	{
+		DecoderContext decoder;
+		const unsigned long long contentSize = ZSTD_getFrameContentSize(frame.data(), frame.size());
+		output.resize(contentSize != ZSTD_CONTENTSIZE_UNKNOWN ? static_cast<std::size_t>(contentSize) : 2 * frame.size());
+		ZSTD_inBuffer in{ frame.data(), frame.size(), 0 };
+		ZSTD_outBuffer out{ output.data(), output.size(), 0 };
+		for (;;)
+		{
+			const std::size_t result = ZSTD_decompressStream(decoder.context, &out, &in);
+			if (ZSTD_isError(result))
+			{
+				throw std::runtime_error("Invalid zstd data.");
+			}
+			if (result == 0)
+			{
+				break;
+			}
+			if (out.pos == out.size)
+			{
+				output.resize(2 * output.size() + 1);
+				out.dst = output.data();
+				out.size = output.size();
+			}
+			else if (in.pos == in.size)
+			{
+				throw std::runtime_error("Unexpected end of compressed file.");
+			}
+		}
+		output.resize(out.pos);
+	}
+
+	class ZstdStream : public InputStream
+	{
+	public:
+		template<typename PathString>
+		ZstdStream(const PathString& filename, unsigned int threadCount)
+			: m_input(filename), m_position(0), m_streaming(false),
+			m_pool(std::make_unique<libply::ThreadPool>(threadCount)), m_window(2 * m_pool->size())
+		{
+		}
+
+		~ZstdStream() override
+		{
+			drain();
+		}
+
+		std::size_t read(char* data, std::size_t size) override
+		{
+			std::size_t produced = 0;
+			while (produced < size)
+			{
+				if (!m_frames.empty())
+				{
+					Frame& frame = *m_frames.front();
+					if (frame.done.valid())
+					{
+						frame.done.get();
+					}
+					const std::size_t count = std::min(size - produced, frame.output.size() - m_position);
+					std::memcpy(data + produced, frame.output.data() + m_position, count);
+					produced += count;
+					m_position += count;
+					if (m_position == frame.output.size())
+					{
+						m_frames.pop_front();
+						m_position = 0;
+						schedule();
+					}
+				}
+				else if (m_streaming)
+				{
+					produced += stream(data + produced, size - produced);
+				}
+				else if (!schedule())
+				{
+					break;
+				}
+			}
+			return produced;
+		}
+
+		void rewind() override
+		{
+			drain();
+			m_input.rewind();
+			m_position = 0;
+			m_streaming = false;
+		}
+
+	private:
+		struct Frame
+		{
+			std::vector<char> input;
+			std::vector<char> output;
+			std::future<void> done;
+		};
+
+		enum class FrameKind
+		{
+			END,
+			PARALLEL,
+			STREAMED
+		};
+
+		// Kind of the frame at the front of the input, with its compressed size when decoded in parallel.
+		FrameKind nextFrame(std::size_t& frameSize)
+		{
+			if (m_input.size() == 0 && !m_input.fill(0))
+			{
+				return FrameKind::END;
+			}
+			for (;;)
+			{
+				const unsigned long long contentSize = ZSTD_getFrameContentSize(m_input.data(), m_input.size());
+				if (contentSize == ZSTD_CONTENTSIZE_ERROR || (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize > MAX_PARALLEL_FRAME_SIZE))
+				{
+					// Invalid data is reported by the stream decoder.
+					return FrameKind::STREAMED;
+				}
+				frameSize = ZSTD_findFrameCompressedSize(m_input.data(), m_input.size());
+				if (!ZSTD_isError(frameSize))
+				{
+					return FrameKind::PARALLEL;
+				}
+				if (m_input.size() >= MAX_PARALLEL_FRAME_INPUT || !m_input.fill(0))
+				{
+					return FrameKind::STREAMED;
+				}
+			}
+		}
+
+		// Queue frames for decoding up to the window, false at the end of the input.
+		bool schedule()
+		{
+			while (!m_streaming && m_frames.size() < m_window)
+			{
+				std::size_t frameSize = 0;
+				const FrameKind kind = nextFrame(frameSize);
+				if (kind == FrameKind::END)
+				{
+					break;
+				}
+				if (kind == FrameKind::STREAMED)
+				{
+					// Frames are delivered in order, the stream starts once the queued ones are consumed.
+					if (m_frames.empty())
+					{
+						ZSTD_DCtx_reset(m_decoder.context, ZSTD_reset_session_only);
+						m_streaming = true;
+					}
+					break;
+				}
+				auto frame = std::make_unique<Frame>();
+				frame->input.assign(m_input.data(), m_input.data() + frameSize);
+				m_input.consume(frameSize);
+				Frame* decoded = frame.get();
+				frame->done = m_pool->submit([decoded]()
+				{
+					decodeFrame(decoded->input, decoded->output);
+					std::vector<char>().swap(decoded->input);
+				});
+				m_frames.push_back(std::move(frame));
+			}
+			return m_streaming || !m_frames.empty();
+		}
+
+		// Decode the streamed frame on the calling thread, until its end or until the output is full.
+		std::size_t stream(char* data, std::size_t size)
+		{
+			ZSTD_outBuffer out{ data, size, 0 };
+			while (out.pos < out.size)
+			{
+				if (m_input.size() == 0 && !m_input.fill(0))
+				{
+					throw std::runtime_error("Unexpected end of compressed file.");
+				}
+				ZSTD_inBuffer in{ m_input.data(), m_input.size(), 0 };
+				const std::size_t result = ZSTD_decompressStream(m_decoder.context, &out, &in);
+				m_input.consume(in.pos);
+				if (ZSTD_isError(result))
+				{
+					throw std::runtime_error("Invalid zstd data.");
+				}
+				if (result == 0)
+				{
+					m_streaming = false;
+					break;
+				}
+			}
+			return out.pos;
+		}
+
+		// Wait for the frames in flight, which refer to the queue, and drop them.
+		void drain()
+		{
+			for (auto& frame : m_frames)
+			{
+				if (frame->done.valid())
+				{
+					frame->done.wait();
+				}
+			}
+			m_frames.clear();
+		}
+
+	private:
+		CompressedInput m_input;
+		DecoderContext m_decoder;
+		std::deque<std::unique_ptr<Frame>> m_frames;
+		// Read position in the front frame.
+		std::size_t m_position;
+		bool m_streaming;
+		std::unique_ptr<libply::ThreadPool> m_pool;
+		std::size_t m_window;
+	};
+#endif
+
+	template<typename PathString>
+	std::unique_ptr<InputStream> open(const PathString& filename, Compression compression, unsigned int threadCount)
+	{
+		switch (compression)
+		{
+		case Compression::NONE:
+			break;
+		case Compression::GZIP:
+#ifdef LIBPLYXX_ZLIB
+			return std::make_unique<GzipStream>(filename);
+#else
+			throw std::runtime_error("Gzip compressed files are not supported by this build.");
+#endif
+		case Compression::ZSTD:
+#ifdef LIBPLYXX_ZSTD
+			return std::make_unique<ZstdStream>(filename, threadCount);
+#else
+			throw std::runtime_error("Zstd compressed files are not supported by this build.");
+#endif
+		}
+		(void)threadCount;
+		throw std::invalid_argument("Not a compressed file.");
+	}
+}
+
+Compression detectCompression(const std::string& filename)
+{
+	return detect(filename);
+}
+
+Compression detectCompression(const char* data, std::size_t size)
+{
+	const unsigned char* magic = reinterpret_cast<const unsigned char*>(data);
+	if (size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+	{
+		return Compression::GZIP;
+	}
+	if (size < 4)
+	{
+		return Compression::NONE;
+	}
+	const std::uint32_t value = magic[0] | (magic[1] << 8) | (magic[2] << 16) | (static_cast<std::uint32_t>(magic[3]) << 24);
+	// A frame, or one of the skippable frames that may precede it.
+	if (value == 0xFD2FB528u || (value & 0xFFFFFFF0u) == 0x184D2A50u)
+	{
+		return Compression::ZSTD;
+	}
+	return Compression::NONE;
+}
+
+std::unique_ptr<InputStream> openDecompressor(const std::string& filename, Compression compression, unsigned int threadCount)
+{
+	return open(filename, compression, threadCount);
+}
+
+#ifdef _WIN32
+Compression detectCompression(const std::wstring& filename)
+{
+	return detect(filename);
+}
+
+std::unique_ptr<InputStream> openDecompressor(const std::wstring& filename, Compression compression, unsigned int threadCount)
+{
+	return open(filename, compression, threadCount);
+}
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "inputstream.h"
+
+#include <memory>
+#include <string>
+
+namespace fileio
+{
+	enum class Compression
+	{
+		NONE,
+		GZIP,
+		ZSTD
+	};
+
+	// Compression of a file, from the magic number of its first frame. NONE if it cannot be read.
+	Compression detectCompression(const std::string& filename);
+	// Compression of data starting with the first size bytes of a file.
+	Compression detectCompression(const char* data, std::size_t size);
+#ifdef _WIN32
+	Compression detectCompression(const std::wstring& filename);
+#endif
+
+	// Streaming decoder of a compressed file, throws if the build lacks support for its compression.
+	// Concatenated gzip members and zstd frames are decoded one after the other. Independent zstd frames
+	// of bounded size are decoded ahead on up to threadCount worker threads, larger ones as a stream.
+	std::unique_ptr<InputStream> openDecompressor(const std::string& filename, Compression compression, unsigned int threadCount);
+#ifdef _WIN32
+	std::unique_ptr<InputStream> openDecompressor(const std::wstring& filename, Compression compression, unsigned int threadCount);
+#endif
+}
@@ -0,0 +1,328 @@
+#include "fileio.h"
+#include "statistics.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#include <cerrno>
+#endif
+
+namespace fileio
+{
+#ifdef _WIN32
+bool fileStatus(const WIN32_FILE_ATTRIBUTE_DATA& data, FileStatus& status)
+{
+	status.size = (static_cast<std::uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+	// FILETIME counts 100 ns intervals.
+	const std::uint64_t time = (static_cast<std::uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+	status.modificationTime = static_cast<std::int64_t>(time) * 100;
+	return true;
+}
+
+bool fileStatus(const std::string& filename, FileStatus& status)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	return GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &data) && fileStatus(data, status);
+}
+
+bool fileStatus(const std::wstring& filename, FileStatus& status)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	return GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &data) && fileStatus(data, status);
+}
+
+MappedFile::MappedFile(const std::string& filename)
+	: m_data(nullptr), m_size(0)
+{
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	map(file);
+}
+
+MappedFile::MappedFile(const std::wstring& filename)
+	: m_data(nullptr), m_size(0)
+{
+	HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	map(file);
+}
+
+void MappedFile::map(void* fileHandle)
+{
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(fileHandle, &size) && size.QuadPart > 0)
+	{
+		HANDLE mapping = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr)
+		{
+			// The view keeps a reference on the mapping and the file, both handles can be closed.
+			m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			if (m_data != nullptr)
+			{
+				m_size = static_cast<std::size_t>(size.QuadPart);
+			}
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(fileHandle);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data != nullptr)
+	{
+		UnmapViewOfFile(m_data);
+	}
+}
+
+void MappedFile::adviseSequential(std::size_t, std::size_t) const
+{
+	// FILE_FLAG_SEQUENTIAL_SCAN was given when opening the file.
+}
+#else
+bool fileStatus(const std::string& filename, FileStatus& status)
+{
+	struct stat st;
+	if (::stat(filename.c_str(), &st) != 0)
+	{
+		return false;
+	}
+	status.size = static_cast<std::uint64_t>(st.st_size);
+#if defined(__APPLE__)
+	status.modificationTime = static_cast<std::int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	status.modificationTime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+MappedFile::MappedFile(const std::string& filename)
+	: m_data(nullptr), m_size(0)
+{
+	map(::open(filename.c_str(), O_RDONLY));
+}
+
+void MappedFile::map(int fd)
+{
+	if (fd < 0)
+	{
+		return;
+	}
+	struct stat st;
+	if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void* address = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (address != MAP_FAILED)
+		{
+			m_data = static_cast<const char*>(address);
+			m_size = static_cast<std::size_t>(st.st_size);
+		}
+	}
+	// The mapping stays valid after the descriptor is closed.
+	::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_data != nullptr)
+	{
+		::munmap(const_cast<char*>(m_data), m_size);
+	}
+}
+
+void MappedFile::adviseSequential(std::size_t offset, std::size_t length) const
+{
+	if (m_data == nullptr || offset >= m_size)
+	{
+		return;
+	}
+	// madvise() requires a page aligned address.
+	const std::size_t pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+	const std::size_t alignedOffset = offset - (offset % pageSize);
+	if (length > m_size - offset)
+	{
+		length = m_size - offset;
+	}
+	::madvise(const_cast<char*>(m_data) + alignedOffset, length + (offset - alignedOffset), MADV_SEQUENTIAL);
+}
+#endif
+
+#ifdef _WIN32
+OutputFile::OutputFile(const std::string& filename, std::size_t bufferSize)
+	: m_handle(CreateFileA(filename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr)),
+	m_buffer(bufferSize), m_size(0)
+{
+	if (m_handle == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Unable to open file for writing.");
+	}
+}
+
+OutputFile::OutputFile(const std::wstring& filename, std::size_t bufferSize)
+	: m_handle(CreateFileW(filename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr)),
+	m_buffer(bufferSize), m_size(0)
+{
+	if (m_handle == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Unable to open file for writing.");
+	}
+}
+
+void OutputFile::preallocate(std::size_t size)
+{
+	FILE_ALLOCATION_INFO info;
+	info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+	SetFileInformationByHandle(m_handle, FileAllocationInfo, &info, sizeof(info));
+}
+
+void OutputFile::writeFile(const char* data, std::size_t size)
+{
+	LIBPLYXX_STATISTICS_ONLY(libply::PhaseTimer timer(&libply::StatisticsCounters::io);)
+	LIBPLYXX_STATISTICS_ONLY(libply::countChunk(size);)
+	while (size > 0)
+	{
+		const DWORD chunk = static_cast<DWORD>(size < (1u << 30) ? size : (1u << 30));
+		DWORD written = 0;
+		if (!WriteFile(m_handle, data, chunk, &written, nullptr))
+		{
+			throw std::runtime_error("Unable to write file.");
+		}
+		data += written;
+		size -= written;
+	}
+}
+
+void OutputFile::close()
+{
+	if (m_handle == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+	flush();
+	HANDLE handle = m_handle;
+	m_handle = INVALID_HANDLE_VALUE;
+	if (!CloseHandle(handle))
+	{
+		throw std::runtime_error("Unable to write file.");
+	}
+}
+
+OutputFile::~OutputFile()
+{
+	if (m_handle != INVALID_HANDLE_VALUE)
+	{
+		try
+		{
+			flush();
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+		CloseHandle(m_handle);
+	}
+}
+#else
+OutputFile::OutputFile(const std::string& filename, std::size_t bufferSize)
+	: m_fd(::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)), m_buffer(bufferSize), m_size(0)
+{
+	if (m_fd < 0)
+	{
+		throw std::runtime_error("Unable to open file for writing.");
+	}
+}
+
+void OutputFile::preallocate(std::size_t size)
+{
+#ifdef __linux__
+	// The file length is unchanged, so a size estimate that is too large costs nothing.
+	::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+#else
+	(void)size;
+#endif
+}
+
+void OutputFile::writeFile(const char* data, std::size_t size)
+{
+	LIBPLYXX_STATISTICS_ONLY(libply::PhaseTimer timer(&libply::StatisticsCounters::io);)
+	LIBPLYXX_STATISTICS_ONLY(libply::countChunk(size);)
+	while (size > 0)
+	{
+		const ssize_t written = ::write(m_fd, data, size);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			throw std::runtime_error("Unable to write file.");
+		}
+		data += written;
+		size -= static_cast<std::size_t>(written);
+	}
+}
+
+void OutputFile::close()
+{
+	if (m_fd < 0)
+	{
+		return;
+	}
+	flush();
+	const int fd = m_fd;
+	m_fd = -1;
+	if (::close(fd) != 0)
+	{
+		throw std::runtime_error("Unable to write file.");
+	}
+}
+
+OutputFile::~OutputFile()
+{
+	if (m_fd >= 0)
+	{
+		try
+		{
+			flush();
+		}
+		catch (const std::runtime_error&)
+		{
+		}
+		::close(m_fd);
+	}
+}
+#endif
+
+void OutputFile::flush()
+{
+	if (m_size > 0)
+	{
+		const std::size_t size = m_size;
+		m_size = 0;
+		writeFile(m_buffer.data(), size);
+	}
+}
+
+void OutputFile::writeLarge(const char* data, std::size_t size)
+{
+	flush();
+	if (size >= m_buffer.size())
+	{
+		// Blocks at least as large as the buffer bypass it.
+		writeFile(data, size);
+	}
+	else
+	{
+		std::memcpy(m_buffer.data(), data, size);
+		m_size = size;
+	}
+}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace fileio
+{
+	// Size and last modification time (in nanoseconds) of a file, false if it cannot be queried.
+	struct FileStatus
+	{
+		std::uint64_t size;
+		std::int64_t modificationTime;
+	};
+
+	bool fileStatus(const std::string& filename, FileStatus& status);
+#ifdef _WIN32
+	bool fileStatus(const std::wstring& filename, FileStatus& status);
+#endif
+
+	// Read-only memory mapping of a whole file.
+	// An empty or unmappable file yields an invalid mapping (see isValid()),
+	// the caller is then expected to fall back to stream reading.
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string& filename);
+#ifdef _WIN32
+		explicit MappedFile(const std::wstring& filename);
+#endif
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+		~MappedFile();
+
+		bool isValid() const { return m_data != nullptr; };
+		const char* data() const { return m_data; };
+		std::size_t size() const { return m_size; };
+
+		// Hint the OS that [offset, offset+length) will be read front to back.
+		void adviseSequential(std::size_t offset, std::size_t length) const;
+
+	private:
+#ifdef _WIN32
+		void map(void* fileHandle);
+#else
+		void map(int fd);
+#endif
+
+	private:
+		const char* m_data;
+		std::size_t m_size;
+	};
+
+	// Write-only file opened once, with output gathered in a large buffer and written in blocks.
+	// The file is created or truncated on construction, errors throw std::runtime_error.
+	class OutputFile
+	{
+	public:
+		static const std::size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+		explicit OutputFile(const std::string& filename, std::size_t bufferSize = DEFAULT_BUFFER_SIZE);
+#ifdef _WIN32
+		explicit OutputFile(const std::wstring& filename, std::size_t bufferSize = DEFAULT_BUFFER_SIZE);
+#endif
+		OutputFile(const OutputFile& other) = delete;
+		OutputFile& operator=(const OutputFile& other) = delete;
+		// Flushes and closes, write errors are ignored, call close() to get them.
+		~OutputFile();
+
+		// Reserve disk space for a file of the given size, without changing its length.
+		// Only a hint, ignored where the platform has no such call.
+		void preallocate(std::size_t size);
+
+		void write(const char* data, std::size_t size)
+		{
+			if (m_size + size <= m_buffer.size())
+			{
+				std::memcpy(m_buffer.data() + m_size, data, size);
+				m_size += size;
+			}
+			else
+			{
+				writeLarge(data, size);
+			}
+		};
+
+		// Room for at least count bytes in the buffer, filled in place and then passed to commit().
+		char* reserve(std::size_t count)
+		{
+			if (m_size + count > m_buffer.size())
+			{
+				flush();
+				if (count > m_buffer.size())
+				{
+					m_buffer.resize(count);
+				}
+			}
+			return m_buffer.data() + m_size;
+		};
+		void commit(char* end) { m_size = static_cast<std::size_t>(end - m_buffer.data()); };
+
+		void setBufferSize(std::size_t size)
+		{
+			flush();
+			m_buffer.resize(size);
+			m_buffer.shrink_to_fit();
+		};
+		void flush();
+		void close();
+
+	private:
+		void writeLarge(const char* data, std::size_t size);
+		void writeFile(const char* data, std::size_t size);
+
+	private:
+#ifdef _WIN32
+		void* m_handle;
+#else
+		int m_fd;
+#endif
+		std::vector<char> m_buffer;
+		std::size_t m_size;
+	};
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace textio
+{
+	// Largest number of characters written by formatReal() in shortest mode, and by formatInteger().
+	const std::size_t MAX_REAL_LENGTH = 25;
+	const std::size_t MAX_INTEGER_LENGTH = 20;
+
+	// Write the shortest decimal representation that parses back to the same value (Ryu algorithm).
+	// Values with a decimal exponent in [-4, 15] use positional notation, others scientific notation.
+	// Returns the end of the written characters, no terminator is appended.
+	char* formatReal(char* out, double value);
+	char* formatReal(char* out, float value);
+
+	// Write the value rounded to the given number of decimals, trailing zeros removed.
+	// Values too large for the precision are written in shortest mode.
+	// At most MAX_REAL_LENGTH characters are written.
+	char* formatReal(char* out, double value, int decimals);
+
+	char* formatUnsigned(char* out, std::uint64_t value);
+
+	template<typename T>
+	char* formatInteger(char* out, T value)
+	{
+		static_assert(std::is_integral<T>::value, "Cannot use formatInteger() with non integral type.");
+		if (std::is_signed<T>::value && value < 0)
+		{
+			*out++ = '-';
+			return formatUnsigned(out, 0 - static_cast<std::uint64_t>(value));
+		}
+		return formatUnsigned(out, static_cast<std::uint64_t>(value));
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace textio
+{
+	// Correctly rounded conversion of a decimal number in [begin, end) to the nearest floating point value.
+	// Accepts an optional sign, digits with an optional fraction and an optional exponent,
+	// other spellings (inf, nan, hexadecimal) are handed to the C library.
+	// Returns the end of the parsed number.
+	const char* parseReal(const char* begin, const char* end, double& value);
+	const char* parseReal(const char* begin, const char* end, float& value);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <stdexcept>
+
+namespace fileio
+{
+	// Sequential source of decoded input bytes, for inputs that cannot be mapped or read in place.
+	// Errors throw std::runtime_error.
+	class InputStream
+	{
+	public:
+		virtual ~InputStream() = default;
+
+		// Read up to size bytes into data and return their count, 0 at the end of the input.
+		virtual std::size_t read(char* data, std::size_t size) = 0;
+		// Restart from the beginning of the input.
+		virtual void rewind() = 0;
+	};
+
+	// Input read from a std::istream, which must outlive it. Only seekable streams can be rewound.
+	class StdInputStream : public InputStream
+	{
+	public:
+		explicit StdInputStream(std::istream& stream)
+			: m_stream(stream), m_start(stream.tellg())
+		{
+			if (m_start < 0)
+			{
+				// Not seekable (e.g. a pipe), the stream is read forward only.
+				m_stream.clear();
+			}
+		};
+
+		std::size_t read(char* data, std::size_t size) override
+		{
+			m_stream.read(data, static_cast<std::streamsize>(size));
+			if (m_stream.bad())
+			{
+				throw std::runtime_error("Could not read stream.");
+			}
+			return static_cast<std::size_t>(m_stream.gcount());
+		};
+
+		void rewind() override
+		{
+			m_stream.clear();
+			if (m_start < 0 || !m_stream.seekg(m_start))
+			{
+				throw std::runtime_error("Could not seek in stream.");
+			}
+		};
+
+	private:
+		std::istream& m_stream;
+		std::streampos m_start;
+	};
+}
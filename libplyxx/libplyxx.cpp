@@ -1,7 +1,9 @@
 #include "libplyxx_internal.h"
 
-#include <fstream>
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 
 namespace libply
 {
@@ -11,6 +13,16 @@ File::File(const PATH_STRING& filename)
 {
 }
 
+File::File(const void* data, std::size_t size)
+	: m_parser(std::make_unique<FileParser>(data, size))
+{
+}
+
+File::File(std::istream& stream)
+	: m_parser(std::make_unique<FileParser>(stream))
+{
+}
+
 File::~File() = default;
 
 std::vector<Element> File::definitions() const 
@@ -24,11 +36,66 @@ void File::setElementReadCallback(std::string elementName, ElementReadCallback&
 	m_parser->setElementReadCallback(elementName, readCallback);
 }
 
+void File::setElementBatchReadCallback(std::string elementName, ElementBatchReadCallback& readCallback, std::size_t batchSize)
+{
+	m_parser->setElementBatchReadCallback(elementName, readCallback, batchSize);
+}
+
+void File::setElementReader(std::string elementName, std::shared_ptr<IElementReader> reader)
+{
+	m_parser->setElementReader(elementName, reader);
+}
+
+void File::setListReadTarget(std::string elementName, ListColumn& target)
+{
+	m_parser->setListReadTarget(elementName, target);
+}
+
+void File::setThreadCount(unsigned int threadCount)
+{
+	m_parser->setThreadCount(threadCount);
+}
+
+void File::setDeliveryOrder(DeliveryOrder order)
+{
+	m_parser->setDeliveryOrder(order);
+}
+
+void File::select(const std::string& elementName, const std::vector<std::string>& propertyNames)
+{
+	m_parser->select(elementName, propertyNames);
+}
+
+void File::setReadAhead(std::size_t chunkSize, unsigned int queueDepth, bool direct)
+{
+	m_parser->setReadAhead(chunkSize, queueDepth, direct);
+}
+
 void File::read()
 { 
 	m_parser->read(); 
 };
 
+Statistics File::statistics() const
+{
+	return m_parser->statistics();
+}
+
+void File::resetStatistics()
+{
+	m_parser->resetStatistics();
+}
+
+void File::buildIndex(std::size_t interval, bool sidecar)
+{
+	m_parser->buildIndex(interval, sidecar);
+}
+
+void File::readRange(const std::string& elementName, std::size_t first, std::size_t count, ElementReadCallback& callback)
+{
+	m_parser->readRange(elementName, first, count, callback);
+}
+
 void addElementDefinition(const textio::Tokenizer::TokenList& tokens, std::vector<ElementDefinition>& elementDefinitions)
 {
 	assert(std::string(tokens.at(0)) == "element");
@@ -70,48 +137,71 @@ Element ElementDefinition::getElement() const
 	return Element(name, size, properties);
 }
 
-FileParser::FileParser(const PATH_STRING& filename)
-	: m_filename(filename),
-	m_lineTokenizer(' '),
-	m_lineReader(filename)
+Element ElementDefinition::getSelectedElement() const
 {
-	readHeader();
+	std::vector<Property> properties;
+	for (const auto& p : this->properties)
+	{
+		if (p.selected)
+		{
+			properties.emplace_back(p.getProperty());
+		}
+	}
+	return Element(name, size, properties);
 }
 
-FileParser::~FileParser() = default;
+bool ElementDefinition::isProjected() const
+{
+	return std::any_of(properties.begin(), properties.end(), [](const PropertyDefinition& p) { return !p.selected; });
+}
 
-std::vector<Element> FileParser::definitions() const
+std::size_t ElementDefinition::binaryStride() const
 {
-	std::vector<Element> elements;
-	for (const auto& e : m_elements)
+	std::size_t stride = 0;
+	for (const auto& p : properties)
 	{
-		elements.emplace_back(e.getElement());
+		if (p.isList)
+		{
+			return 0;
+		}
+		stride += p.typeSize;
 	}
-	return elements;
+	return stride;
+}
+
+const char* peekOrThrow(textio::LineReader& reader, std::size_t count)
+{
+	const char* data = reader.peek(count);
+	if (data == nullptr)
+	{
+		throw std::runtime_error("Unexpected end of file.");
+	}
+	return data;
 }
 
-void FileParser::readHeader()
+// Parse the header up to end_header, the reader then stands at the data.
+void readHeader(textio::LineReader& reader, File::Format& format, std::vector<ElementDefinition>& elements, std::streamsize& dataOffset)
 {
 	// Read PLY magic number.
-	std::string line = m_lineReader.getline();
+	std::string line = reader.getline();
 	if (line != "ply")
 	{
 		throw std::runtime_error("Invalid file format.");
 	}
 
 	// Read file format.
-	line = m_lineReader.getline();
+	line = reader.getline();
 	if (line == "format ascii 1.0")
 	{
-		m_format = File::Format::ASCII;
+		format = File::Format::ASCII;
 	}
 	else if (line == "format binary_little_endian 1.0")
 	{
-		m_format = File::Format::BINARY_LITTLE_ENDIAN;
+		format = File::Format::BINARY_LITTLE_ENDIAN;
 	}
 	else if (line == "format binary_big_endian 1.0")
 	{
-		m_format = File::Format::BINARY_BIG_ENDIAN;
+		format = File::Format::BINARY_BIG_ENDIAN;
 	}
 	else
 	{
@@ -120,7 +210,7 @@ void FileParser::readHeader()
 
 	// Read mesh elements properties.
 	textio::SubString line_substring;
-	line_substring = m_lineReader.getline();
+	line_substring = reader.getline();
 	line = line_substring;
 	textio::Tokenizer spaceTokenizer(' ');
 	auto tokens = spaceTokenizer.tokenize(line);
@@ -130,383 +220,1949 @@ void FileParser::readHeader()
 		const std::string lineType = tokens.at(0);
 		if (lineType == "element")
 		{
-			addElementDefinition(tokens, m_elements);
+			addElementDefinition(tokens, elements);
 		}
 		else if (lineType == "property")
 		{
-			addProperty(tokens, m_elements.back());
+			addProperty(tokens, elements.back());
 		}
 		else
 		{
 			//throw std::runtime_error("Invalid header line.");
 		}
 
-		line_substring = m_lineReader.getline();
+		line_substring = reader.getline();
 		line = line_substring;
 		tokens = spaceTokenizer.tokenize(line);
 	}
 	
-	m_dataOffset = m_lineReader.position(line_substring.end()) + 1;
+	dataOffset = reader.position(line_substring.end()) + 1;
 }
 
-void FileParser::setElementReadCallback(std::string elementName, ElementReadCallback& callback)
-{
-	m_readCallbackMap[elementName] = callback;
-}
+// Headers are usually well under a kilobyte, longer ones grow the buffer of the probe.
+const std::size_t PROBE_BUFFER_SIZE = 4096;
 
-void FileParser::read()
+FileHeader probeHeader(const PATH_STRING& filename)
 {
-	std::size_t totalLines = 0;
-	for (auto& e : m_elements)
+	auto reader = std::make_unique<textio::LineReader>(filename, false, PROBE_BUFFER_SIZE);
+	const char* magic = reader->peek(4);
+	const fileio::Compression compression = magic ? fileio::detectCompression(magic, 4) : fileio::Compression::NONE;
+	if (compression != fileio::Compression::NONE)
 	{
-		totalLines += e.size;
+		reader = std::make_unique<textio::LineReader>(fileio::openDecompressor(filename, compression, 1));
 	}
 
-	std::vector<std::shared_ptr<ElementBuffer>> buffers;
-	for (auto& e : m_elements)
+	FileHeader header;
+	std::vector<ElementDefinition> elements;
+	std::streamsize dataOffset;
+	readHeader(*reader, header.format, elements, dataOffset);
+	for (const auto& e : elements)
 	{
-		buffers.emplace_back(std::make_shared<ElementBuffer>(e));
+		header.definitions.emplace_back(e.getElement());
 	}
+	header.dataOffset = static_cast<std::uint64_t>(dataOffset);
+	return header;
+}
 
-	std::size_t lineIndex = 0;
-	std::size_t elementIndex = 0;
-	ElementReadCallback readCallback = m_readCallbackMap.at(m_elements.at(elementIndex).name);
-	auto& elementDefinition = m_elements.at(elementIndex);
-	const std::size_t maxElementIndex = m_elements.size();
-	
-	std::shared_ptr<ElementBuffer> buffer = buffers[elementIndex];
-
-	std::ifstream& filestream = m_lineReader.filestream();
-
-	if (m_format == File::Format::BINARY_BIG_ENDIAN || m_format == File::Format::BINARY_LITTLE_ENDIAN)
+std::vector<HeaderProbe> probeHeaders(const std::vector<PATH_STRING>& filenames, unsigned int threadCount)
+{
+	std::vector<HeaderProbe> probes(filenames.size());
+	if (threadCount == 0)
 	{
-		filestream.clear();
-		filestream.seekg(m_dataOffset);
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
 	}
+	threadCount = static_cast<unsigned int>(std::min<std::size_t>(threadCount, filenames.size()));
 
-	while (lineIndex < totalLines)
+	// Files are handed out one at a time, as their probes take very different times.
+	std::atomic<std::size_t> next(0);
+	auto probe = [&filenames, &probes, &next]()
 	{
-		const auto nextElementIndex = elementIndex + 1;
-		if (nextElementIndex < maxElementIndex && lineIndex >= m_elements[nextElementIndex].startLine)
-		{
-			elementIndex = nextElementIndex;
-			readCallback = m_readCallbackMap.at(m_elements.at(elementIndex).name);
-			elementDefinition = m_elements.at(elementIndex);
-
-			buffer = buffers[elementIndex];
-		}
-
-		if (m_format == File::Format::ASCII)
+		for (std::size_t i = next++; i < filenames.size(); i = next++)
 		{
-			auto line = m_lineReader.getline();
-			parseLine(line, elementDefinition, *buffer);
+			probes[i].filename = filenames[i];
+			try
+			{
+				probes[i].header = probeHeader(filenames[i]);
+			}
+			catch (const std::exception& e)
+			{
+				probes[i].error = e.what();
+			}
 		}
-		else {
-			readBinaryElement(filestream, elementDefinition, *buffer);
-		}
-		
-		readCallback(*buffer);
-		++lineIndex;
+	};
+	ThreadPool pool(threadCount);
+	std::deque<std::future<void>> pending;
+	for (unsigned int t = 0; t < threadCount; ++t)
+	{
+		pending.push_back(pool.submit(probe));
 	}
+	waitAll(pending);
+	return probes;
 }
 
-void FileParser::parseLine(const textio::SubString& line, const ElementDefinition& elementDefinition, ElementBuffer& elementBuffer)
+FileParser::FileParser(const PATH_STRING& filename)
+	: m_filename(filename),
+	m_compression(fileio::detectCompression(filename)),
+	m_data(nullptr),
+	m_size(0),
+	m_threadCount(1),
+	m_deliveryOrder(File::DeliveryOrder::FILE_ORDER),
+	m_index{ 0, {} }
 {
-	m_lineTokenizer.tokenize(line, m_tokens);
-	const auto& properties = elementDefinition.properties;
-
-	if (!properties.front().isList)
+	if (m_compression != fileio::Compression::NONE)
 	{
-		for (size_t i = 0; i < elementBuffer.size(); ++i)
-		{
-			properties[i].conversionFunction(m_tokens[i], elementBuffer[i]);
-		}
+		// Independent frames are decompressed concurrently, whatever the thread count of the decoding.
+		const unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+		m_lineReader = std::make_unique<textio::LineReader>(fileio::openDecompressor(filename, m_compression, threadCount));
+	}
+	else if ((m_mappedFile = std::make_unique<fileio::MappedFile>(filename))->isValid())
+	{
+		// Parse the header and the data in place, straight from the mapped pages.
+		m_mappedFile->adviseSequential(0, m_mappedFile->size());
+		m_data = m_mappedFile->data();
+		m_size = m_mappedFile->size();
+		m_lineReader = std::make_unique<textio::LineReader>(m_data, m_size);
 	}
 	else
 	{
-		const auto& conversionFunction = properties[0].conversionFunction;
-		size_t listLength = std::stoi(m_tokens[0]);
-		elementBuffer.reset(listLength);
-		for (size_t i = 0; i < elementBuffer.size(); ++i)
-		{
-			conversionFunction(m_tokens[i+1], elementBuffer[i]);
-		}
+		m_mappedFile.reset();
+		m_lineReader = std::make_unique<textio::LineReader>(filename);
 	}
+	open();
 }
 
-void FileParser::readBinaryElement(std::ifstream& fs, const ElementDefinition& elementDefinition, ElementBuffer& elementBuffer)
+FileParser::FileParser(const void* data, std::size_t size)
+	: m_compression(fileio::Compression::NONE),
+	m_data(static_cast<const char*>(data)),
+	m_size(size),
+	m_threadCount(1),
+	m_deliveryOrder(File::DeliveryOrder::FILE_ORDER),
+	m_index{ 0, {} }
 {
-	const auto& properties = elementDefinition.properties;
-	const unsigned int MAX_PROPERTY_SIZE = 8;
-	char buffer[MAX_PROPERTY_SIZE];
+	m_lineReader = std::make_unique<textio::LineReader>(m_data, m_size);
+	open();
+}
 
-	if (!properties.front().isList)
-	{
-		for (size_t i = 0; i < elementBuffer.size(); ++i)
-		{
-			const auto size = TYPE_SIZE_MAP.at(properties[i].type);
-			fs.read(buffer, size);
-			properties[i].castFunction(buffer, elementBuffer[i]);
-		}
-	}
-	else
-	{
-		const auto lengthType = properties[0].listLengthType;
-		const auto lengthTypeSize = TYPE_SIZE_MAP.at(lengthType);
-		fs.read(buffer, lengthTypeSize);
-		size_t length = static_cast<size_t>(*buffer);
-		elementBuffer.reset(length);
+FileParser::FileParser(std::istream& stream)
+	: m_compression(fileio::Compression::NONE),
+	m_data(nullptr),
+	m_size(0),
+	m_threadCount(1),
+	m_deliveryOrder(File::DeliveryOrder::FILE_ORDER),
+	m_index{ 0, {} }
+{
+	std::unique_ptr<fileio::InputStream> input = std::make_unique<fileio::StdInputStream>(stream);
+	m_lineReader = std::make_unique<textio::LineReader>(std::move(input));
+	open();
+}
 
-		const auto& castFunction = properties[0].castFunction;
-		const auto size = TYPE_SIZE_MAP.at(properties[0].type);
-		for (size_t i = 0; i < elementBuffer.size(); ++i)
-		{
-			fs.read(buffer, size);
-			castFunction(buffer, elementBuffer[i]);
-		}
-	}
+void FileParser::open()
+{
+	readHeader(*m_lineReader, m_format, m_elements, m_dataOffset);
+	m_swapBytes = m_format != File::Format::ASCII && !isHostByteOrder(m_format);
+	resetStatistics();
 }
 
-ElementBuffer::ElementBuffer(const ElementDefinition& definition)
-	: m_isList(false)
+FileParser::~FileParser() = default;
+
+void FileParser::setReadAhead(std::size_t chunkSize, unsigned int queueDepth, bool direct)
 {
-	auto& properties = definition.properties;
-	for (auto& p : properties)
+	if (m_compression != fileio::Compression::NONE || m_filename.empty())
 	{
-		if (p.isList)
-		{
-			appendListProperty(p.type);
-		}
-		else
-		{
-			appendScalarProperty(p.type);
-		}
+		return;
 	}
+	// Reads and cursors all seek to their data, the reader may be replaced at any time.
+	LIBPLYXX_STATISTICS_ONLY(StatisticsScope statistics(m_statistics, &m_statisticsMutex, &Statistics::bytesRead);)
+	auto readAhead = std::make_unique<fileio::ReadAhead>(m_filename, chunkSize, queueDepth, direct);
+	m_lineReader = std::make_unique<textio::LineReader>(std::move(readAhead), m_dataOffset);
+	m_mappedFile.reset();
+	m_data = nullptr;
+	m_size = 0;
+}
 
+Statistics FileParser::statistics() const
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	return m_statistics;
 }
 
-void ElementBuffer::reset(size_t size)
+void FileParser::resetStatistics()
 {
-	if (properties.size() < size)
+	std::vector<std::string> names;
+	for (const auto& e : m_elements)
 	{
-		while (properties.size() < size)
-		{
-			properties.emplace_back(std::move(getScalarProperty(m_listType)));
-		}
+		names.push_back(e.name);
 	}
-	else
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	m_statistics = emptyStatistics(names);
+}
+
+std::vector<Element> FileParser::definitions() const
+{
+	std::vector<Element> elements;
+	for (const auto& e : m_elements)
 	{
-		properties.resize(size);
+		elements.emplace_back(e.getElement());
 	}
+	return elements;
 }
 
-IScalarProperty& ElementBuffer::operator[](size_t index)
+void FileParser::setElementReadCallback(std::string elementName, ElementReadCallback& callback)
 {
-	return *properties[index];
+	m_batchReadCallbackMap.erase(elementName);
+	m_readerMap.erase(elementName);
+	m_listTargetMap.erase(elementName);
+	m_readCallbackMap[elementName] = callback;
 }
 
-void ElementBuffer::appendScalarProperty(Type type)
+void FileParser::setElementBatchReadCallback(std::string elementName, ElementBatchReadCallback& callback, std::size_t batchSize)
 {
-	std::unique_ptr<IScalarProperty> prop = getScalarProperty(type);
-	properties.push_back(std::move(prop));
+	if (batchSize == 0)
+	{
+		throw std::invalid_argument("Batch size must be greater than zero.");
+	}
+	m_readCallbackMap.erase(elementName);
+	m_readerMap.erase(elementName);
+	m_listTargetMap.erase(elementName);
+	m_batchReadCallbackMap[elementName] = BatchReadCallback{ callback, batchSize };
 }
 
-void ElementBuffer::appendListProperty(Type type)
+void FileParser::setElementReader(std::string elementName, std::shared_ptr<IElementReader> reader)
 {
-	m_isList = true;
-	m_listType = type;
+	m_readCallbackMap.erase(elementName);
+	m_batchReadCallbackMap.erase(elementName);
+	m_listTargetMap.erase(elementName);
+	m_readerMap[elementName] = reader;
 }
 
-std::unique_ptr<IScalarProperty> ElementBuffer::getScalarProperty(Type type)
+void FileParser::setListReadTarget(std::string elementName, ListColumn& target)
 {
-	std::unique_ptr<IScalarProperty> prop;
-	switch (type)
+	const auto& properties = elementDefinition(elementName).properties;
+	if (properties.size() != 1 || !properties.front().isList)
 	{
-	case Type::UCHAR: prop = std::make_unique<ScalarProperty<char>>();  break;
-	case Type::INT: prop = std::make_unique<ScalarProperty<int>>(); break;
-	case Type::FLOAT: prop = std::make_unique<ScalarProperty<float>>(); break;
-	case Type::DOUBLE: prop = std::make_unique<ScalarProperty<double>>(); break;
+		throw std::invalid_argument("Element " + elementName + " is not made of a single list property.");
 	}
-	return std::move(prop);
+	m_readCallbackMap.erase(elementName);
+	m_batchReadCallbackMap.erase(elementName);
+	m_readerMap.erase(elementName);
+	m_listTargetMap[elementName] = &target;
 }
 
-std::string formatString(File::Format format)
+ElementDefinition& FileParser::elementDefinition(const std::string& elementName)
 {
-	switch (format)
+	auto element = std::find_if(m_elements.begin(), m_elements.end(),
+		[&elementName](const ElementDefinition& e) { return e.name == elementName; });
+	if (element == m_elements.end())
 	{
-	case File::Format::ASCII: return "ascii";
-	case File::Format::BINARY_BIG_ENDIAN: return "binary_big_endian";
-	case File::Format::BINARY_LITTLE_ENDIAN: return "binary_little_endian";
+		throw std::invalid_argument("Unknown element: " + elementName);
 	}
-	return "";
+	return *element;
 }
 
-std::string typeString(Type type)
+void FileParser::select(const std::string& elementName, const std::vector<std::string>& propertyNames)
 {
-	switch (type)
+	auto& element = elementDefinition(elementName);
+	for (const auto& name : propertyNames)
 	{
-	case Type::UCHAR: return "uchar";
-	case Type::INT: return "int";
-	case Type::FLOAT: return "float";
-	case Type::DOUBLE: return "double";
+		auto property = std::find_if(element.properties.begin(), element.properties.end(),
+			[&name](const PropertyDefinition& p) { return p.name == name; });
+		if (property == element.properties.end())
+		{
+			throw std::invalid_argument("Unknown property: " + name);
+		}
+	}
+	if (propertyNames.empty())
+	{
+		throw std::invalid_argument("At least one property must be selected.");
+	}
+	for (auto& p : element.properties)
+	{
+		p.selected = std::find(propertyNames.begin(), propertyNames.end(), p.name) != propertyNames.end();
 	}
-	return "";
 }
 
-void writePropertyDefinition(std::ofstream& file, const Property& propertyDefinition)
+FileParser::ElementHandler FileParser::elementHandler(const ElementDefinition& elementDefinition)
 {
-	if (propertyDefinition.isList)
+	ElementHandler handler{ nullptr, nullptr, nullptr, nullptr, DEFAULT_BATCH_SIZE, false, false };
+	auto listTarget = m_listTargetMap.find(elementDefinition.name);
+	auto reader = m_readerMap.find(elementDefinition.name);
+	auto batchCallback = m_batchReadCallbackMap.find(elementDefinition.name);
+	auto elementCallback = m_readCallbackMap.find(elementDefinition.name);
+	if (listTarget != m_listTargetMap.end())
+	{
+		handler.listTarget = listTarget->second;
+		handler.listTarget->reset(elementDefinition.properties.front().type);
+	}
+	else if (reader != m_readerMap.end())
+	{
+		handler.reader = reader->second.get();
+		const bool rowsAvailable = m_format != File::Format::ASCII && isHostByteOrder(m_format)
+			&& elementDefinition.binaryStride() != 0 && !elementDefinition.isProjected();
+		handler.readRows = handler.reader->begin(elementDefinition.getSelectedElement(), rowsAvailable) && rowsAvailable;
+	}
+	else if (batchCallback != m_batchReadCallbackMap.end())
+	{
+		handler.batchCallback = &batchCallback->second.callback;
+		handler.batchSize = batchCallback->second.batchSize;
+	}
+	else if (elementCallback != m_readCallbackMap.end())
 	{
-		file << "property list uchar ";
+		handler.elementCallback = &elementCallback->second;
 	}
 	else
 	{
-		file << "property ";
+		handler.skip = true;
 	}
-	file << typeString(propertyDefinition.type) << " " << propertyDefinition.name << '\n';
+	return handler;
 }
 
-void writeElementDefinition(std::ofstream& file, const Element& elementDefinition)
+void FileParser::read()
 {
-	file << "element " << elementDefinition.name << " " << elementDefinition.size << '\n';
-	for (const auto& prop : elementDefinition.properties)
+	LIBPLYXX_STATISTICS_ONLY(StatisticsScope statistics(m_statistics, &m_statisticsMutex, &Statistics::bytesRead);)
+	// Index building and range reads leave the reader anywhere in the data.
+	m_lineReader->seek(m_dataOffset);
+#ifdef LIBPLYXX_STATISTICS
+	if (m_data)
 	{
-		writePropertyDefinition(file, prop);
+		// Mapped pages are read by the kernel on first access, the whole data counts as read.
+		countBytes(m_size - m_dataOffset);
 	}
-}
+#endif
 
-void writeTextProperties(std::ofstream& file, ElementBuffer& buffer, const ElementDefinition& elementDefinition)
-{
-	std::stringstream ss;
-	if (elementDefinition.properties.front().isList)
+	std::vector<ElementHandler> handlers;
+	for (const auto& elementDefinition : m_elements)
 	{
-		file << buffer.size() << " ";
-		auto& convert = elementDefinition.properties.front().writeConvertFunction;
-		for (size_t i = 0; i < buffer.size(); ++i)
-		{
-			ss.clear();
-			ss.str(std::string());
-			file << convert(buffer[i], ss).str() << " ";
-		}
+		handlers.push_back(elementHandler(elementDefinition));
 	}
-	else
+
+	// Parallel decoding needs random access to the data, i.e. a mapped file or a memory buffer.
+	std::unique_ptr<ThreadPool> pool;
+	if (m_threadCount > 1 && m_data)
 	{
-		for (size_t i = 0; i < buffer.size(); ++i)
+		pool = std::make_unique<ThreadPool>(m_threadCount);
+	}
+
+	if (pool && m_format == File::Format::ASCII)
+	{
+		readTextParallel(*pool, handlers);
+		return;
+	}
+
+	// Sections of elements holding lists must be scanned, fixed size ones may be split between threads.
+	const std::size_t MIN_PARALLEL_SIZE = 1024 * 1024;
+	for (std::size_t i = 0; i < m_elements.size(); ++i)
+	{
+		const auto& elementDefinition = m_elements[i];
+		auto& handler = handlers[i];
+		if (handler.skip)
 		{
-			auto& convert = elementDefinition.properties.at(i).writeConvertFunction;
-			ss.clear();
-			ss.str(std::string());
-			file << convert(buffer[i], ss).str() << " ";
+			skipElements(elementDefinition, elementDefinition.size);
+		}
+		else if (handler.readRows)
+		{
+			readElementRows(elementDefinition, *handler.reader);
+		}
+		else if (handler.listTarget && m_format != File::Format::ASCII)
+		{
+			readListColumn(elementDefinition, *handler.listTarget);
+		}
+		else if (pool && elementDefinition.binaryStride() * elementDefinition.size >= MIN_PARALLEL_SIZE)
+		{
+			readBinaryParallel(*pool, i, handlers);
+		}
+		else if (handler.elementCallback)
+		{
+			readElements(elementDefinition, elementDefinition.size, *handler.elementCallback);
+		}
+		else
+		{
+			readElementBatches(elementDefinition, handler);
 		}
 	}
-	file << '\n';
 }
 
-void writeBinaryProperties(std::ofstream& file, ElementBuffer& buffer, const ElementDefinition& elementDefinition)
+#ifdef LIBPLYXX_STATISTICS
+void countBatch(std::size_t element, const ElementBatch& batch)
 {
-	const unsigned int MAX_PROPERTY_SIZE = 8;
-	char write_buffer[MAX_PROPERTY_SIZE];
+	const std::size_t values = batch.isList() ? batch.listOffsets()[batch.size()] : batch.size() * batch.propertyCount();
+	countElements(element, batch.size(), values);
+}
+#endif
 
-	if (elementDefinition.properties.front().isList)
+void FileParser::readElements(const ElementDefinition& elementDefinition, std::size_t count, ElementReadCallback& readCallback)
+{
+	LIBPLYXX_STATISTICS_ONLY(const std::size_t element = &elementDefinition - m_elements.data();)
+	ElementBuffer buffer(elementDefinition);
+	if (m_format == File::Format::ASCII)
 	{
-		unsigned char list_size = static_cast<unsigned char>(buffer.size());
-		file.write(reinterpret_cast<char*>(&list_size), sizeof(list_size));
-
-		auto& cast = elementDefinition.properties.front().writeCastFunction;
-		for (size_t i = 0; i < buffer.size(); ++i)
+		TextDecoder decoder(elementDefinition);
+		for (std::size_t i = 0; i < count;)
 		{
-			size_t write_size;
-			cast(buffer[i], write_buffer, write_size);
-			file.write(reinterpret_cast<char*>(write_buffer), write_size);
+			const auto text = m_lineReader->lines();
+			const char* position = text.begin();
+			for (; i < count && position != text.end(); ++i)
+			{
+				position = decoder.decode(position, text.end(), buffer);
+				LIBPLYXX_STATISTICS_ONLY(countElements(element, 1, buffer.size());)
+				LIBPLYXX_STATISTICS_ONLY(PhaseTimer timer(&StatisticsCounters::callback);)
+				readCallback(buffer);
+			}
+			m_lineReader->skip(position - text.begin());
+			if (text.begin() == text.end() && i < count)
+			{
+				throw std::runtime_error("Unexpected end of file.");
+			}
 		}
+		return;
 	}
-	else
+	if (elementDefinition.binaryStride() != 0)
 	{
-		for (size_t i = 0; i < buffer.size(); ++i)
+		// Fixed size rows are decoded by batches, byte swapped a column at a time.
+		ElementBatch batch(elementDefinition, std::min(count, DEFAULT_BATCH_SIZE));
+		for (std::size_t first = 0; first < count; first += DEFAULT_BATCH_SIZE)
 		{
-			auto& cast = elementDefinition.properties.at(i).writeCastFunction;
-			size_t write_size;
-			cast(buffer[i], write_buffer, write_size);
-			file.write(reinterpret_cast<char*>(write_buffer), write_size);
+			batch.clear(first);
+			readBatch(elementDefinition, std::min(DEFAULT_BATCH_SIZE, count - first), batch);
+			for (std::size_t i = 0; i < batch.size(); ++i)
+			{
+				copyElement(batch, i, buffer);
+				LIBPLYXX_STATISTICS_ONLY(countElements(element, 1, buffer.size());)
+				LIBPLYXX_STATISTICS_ONLY(PhaseTimer timer(&StatisticsCounters::callback);)
+				readCallback(buffer);
+			}
 		}
+		return;
+	}
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		// The line reader stands right after the header, binary data is decoded from its buffer.
+		readBinaryElement(elementDefinition, buffer);
+		LIBPLYXX_STATISTICS_ONLY(countElements(element, 1, buffer.size());)
+		LIBPLYXX_STATISTICS_ONLY(PhaseTimer timer(&StatisticsCounters::callback);)
+		readCallback(buffer);
 	}
 }
 
-void writeProperties(std::ofstream& file, ElementBuffer& buffer, size_t index, const ElementDefinition& elementDefinition, File::Format format, ElementWriteCallback& callback)
+void FileParser::skipElements(const ElementDefinition& elementDefinition, std::size_t count)
 {
-	callback(buffer, index);
-	if (format == File::Format::ASCII)
+	textio::LineReader& reader = *m_lineReader;
+	const std::size_t stride = elementDefinition.binaryStride();
+	if (m_format == File::Format::ASCII)
+	{
+		reader.skipLines(count);
+	}
+	else if (stride != 0)
 	{
-		writeTextProperties(file, buffer, elementDefinition);
+		reader.seek(reader.tell() + static_cast<std::streamsize>(count * stride));
 	}
 	else
 	{
-		writeBinaryProperties(file, buffer, elementDefinition);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			for (const auto& p : elementDefinition.properties)
+			{
+				std::size_t size = p.typeSize;
+				if (p.isList)
+				{
+					size *= readListLength(peekOrThrow(reader, p.listLengthTypeSize), p.listLengthType, m_swapBytes);
+					reader.skip(p.listLengthTypeSize);
+				}
+				peekOrThrow(reader, size);
+				reader.skip(size);
+			}
+		}
 	}
 }
 
-void writeElements(std::ofstream& file, const Element& elementDefinition, File::Format format, ElementWriteCallback& callback)
+void FileParser::buildIndex(std::size_t interval, bool sidecar)
 {
-	const size_t size = elementDefinition.size;
-	ElementBuffer buffer(elementDefinition);
-	buffer.reset(elementDefinition.properties.size());
-	for (size_t i = 0; i < size; ++i)
+	if (interval == 0)
 	{
-		writeProperties(file, buffer, i, elementDefinition, format, callback);
+		throw std::invalid_argument("Index interval must be greater than zero.");
+	}
+	LIBPLYXX_STATISTICS_ONLY(StatisticsScope statistics(m_statistics, &m_statisticsMutex, &Statistics::bytesRead);)
+	const PATH_STRING sidecarName = m_filename + Str(".plyidx");
+	fileio::FileStatus status;
+	const bool validStatus = sidecar && fileio::fileStatus(m_filename, status);
+	if (validStatus && loadIndex(sidecarName, status, interval))
+	{
+		return;
 	}
-}
 
-FileOut::FileOut(const PATH_STRING& filename, File::Format format)
-	: m_filename(filename), m_format(format)
-{
-	createFile();
-}
+	m_index.interval = interval;
+	m_index.sections.assign(m_elements.size(), std::vector<std::uint64_t>());
+	m_lineReader->seek(m_dataOffset);
+	LIBPLYXX_STATISTICS_ONLY(const std::streamsize start = m_lineReader->tell();)
+	for (std::size_t e = 0; e < m_elements.size(); ++e)
+	{
+		const auto& elementDefinition = m_elements[e];
+		auto& offsets = m_index.sections[e];
+		if (m_format != File::Format::ASCII && elementDefinition.binaryStride() != 0)
+		{
+			offsets.push_back(m_lineReader->tell());
+			skipElements(elementDefinition, elementDefinition.size);
+			continue;
+		}
+		offsets.reserve(elementDefinition.size / interval + 1);
+		for (std::size_t first = 0; first < elementDefinition.size; first += interval)
+		{
+			offsets.push_back(m_lineReader->tell());
+			skipElements(elementDefinition, std::min(interval, elementDefinition.size - first));
+		}
+	}
 
-void FileOut::setElementsDefinition(const ElementsDefinition& definitions)
-{
-	m_definitions = definitions;
+#ifdef LIBPLYXX_STATISTICS
+	if (m_data)
+	{
+		countBytes(m_lineReader->tell() - start);
+	}
+#endif
+	if (validStatus)
+	{
+		saveIndex(sidecarName, status);
+	}
 }
 
-void FileOut::setElementWriteCallback(const std::string& elementName, ElementWriteCallback& writeCallback)
-{
-	m_writeCallbacks[elementName] = writeCallback;
-}
+// Sidecar layout, in host byte order: magic, file size, file modification time, interval,
+// section count, then for each section its offset count followed by the offsets.
+const char INDEX_MAGIC[8] = { 'p', 'l', 'y', 'i', 'd', 'x', '1', '\0' };
 
-void FileOut::write()
+bool FileParser::loadIndex(const PATH_STRING& filename, const fileio::FileStatus& status, std::size_t interval)
 {
-	writeHeader();
-	writeData();
-}
+	std::ifstream file(filename, std::ios::binary);
+	char magic[sizeof(INDEX_MAGIC)];
+	std::uint64_t header[4];
+	if (!file.read(magic, sizeof(magic)) || !file.read(reinterpret_cast<char*>(header), sizeof(header))
+		|| std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0
+		|| header[0] != status.size || static_cast<std::int64_t>(header[1]) != status.modificationTime
+		|| header[2] != interval || header[3] != m_elements.size())
+	{
+		return false;
+	}
 
-void FileOut::createFile()
-{
-	std::ofstream f(m_filename, std::ios::trunc);
-	f.close();
+	std::vector<std::vector<std::uint64_t>> sections(m_elements.size());
+	for (std::size_t e = 0; e < sections.size(); ++e)
+	{
+		std::uint64_t count;
+		if (!file.read(reinterpret_cast<char*>(&count), sizeof(count)) || count > m_elements[e].size + 1)
+		{
+			return false;
+		}
+		sections[e].resize(static_cast<std::size_t>(count));
+		if (!file.read(reinterpret_cast<char*>(sections[e].data()), count * sizeof(std::uint64_t)))
+		{
+			return false;
+		}
+	}
+	m_index.interval = interval;
+	m_index.sections = std::move(sections);
+	return true;
 }
 
-void FileOut::writeHeader()
+void FileParser::saveIndex(const PATH_STRING& filename, const fileio::FileStatus& status) const
 {
-	std::ofstream file(m_filename, std::ios::out | std::ios::binary);
-
-	file << "ply" << std::endl;
-	file << "format " << formatString(m_format) << " 1.0" << std::endl;
-	for (const auto& def : m_definitions)
+	// The sidecar is only a cache, the index stays usable in memory when it cannot be written.
+	try
 	{
-		writeElementDefinition(file, def);
+		fileio::OutputFile file(filename, 64 * 1024);
+		const std::uint64_t header[4] = { status.size, static_cast<std::uint64_t>(status.modificationTime),
+			m_index.interval, m_index.sections.size() };
+		file.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		for (const auto& offsets : m_index.sections)
+		{
+			const std::uint64_t count = offsets.size();
+			file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+			file.write(reinterpret_cast<const char*>(offsets.data()), count * sizeof(std::uint64_t));
+		}
+		file.close();
+	}
+	catch (const std::runtime_error&)
+	{
+	}
+}
+
+void FileParser::readRange(const std::string& elementName, std::size_t first, std::size_t count, ElementReadCallback& callback)
+{
+	const auto& element = elementDefinition(elementName);
+	if (first > element.size || count > element.size - first)
+	{
+		throw std::out_of_range("Element range out of bounds.");
+	}
+	LIBPLYXX_STATISTICS_ONLY(StatisticsScope statistics(m_statistics, &m_statisticsMutex, &Statistics::bytesRead);)
+	if (m_index.sections.empty())
+	{
+		buildIndex(DEFAULT_INDEX_INTERVAL, false);
+	}
+
+	const auto& offsets = m_index.sections[&element - m_elements.data()];
+	const std::size_t stride = element.binaryStride();
+	if (m_format != File::Format::ASCII && stride != 0)
+	{
+		m_lineReader->seek(static_cast<std::streamsize>(offsets.front() + first * stride));
+	}
+	else
+	{
+		if (offsets.empty())
+		{
+			return;
+		}
+		// An empty range may start right after the last element, which has no entry.
+		const std::size_t entry = std::min(first / m_index.interval, offsets.size() - 1);
+		m_lineReader->seek(static_cast<std::streamsize>(offsets[entry]));
+		skipElements(element, first - entry * m_index.interval);
+	}
+	LIBPLYXX_STATISTICS_ONLY(const std::streamsize start = m_lineReader->tell();)
+	readElements(element, count, callback);
+#ifdef LIBPLYXX_STATISTICS
+	if (m_data)
+	{
+		countBytes(m_lineReader->tell() - start);
+	}
+#endif
+}
+
+void FileParser::readElementBatches(const ElementDefinition& elementDefinition, ElementHandler& handler)
+{
+	const std::size_t batchSize = handler.batchSize;
+	ElementBatch batch(elementDefinition, batchSize);
+	for (std::size_t first = 0; first < elementDefinition.size; first += batchSize)
+	{
+		batch.clear(first);
+		readBatch(elementDefinition, std::min(batchSize, elementDefinition.size - first), batch);
+		deliver(elementDefinition, handler, batch);
+	}
+}
+
+void FileParser::readBatch(const ElementDefinition& elementDefinition, std::size_t count, ElementBatch& batch)
+{
+	const std::size_t stride = elementDefinition.binaryStride();
+	if (m_format != File::Format::ASCII && stride != 0)
+	{
+		decodeRows(peekOrThrow(*m_lineReader, count * stride), count, elementDefinition, batch, m_swapBytes);
+		m_lineReader->skip(count * stride);
+	}
+	if (m_format == File::Format::ASCII)
+	{
+		// Whole runs of buffered lines are decoded at once.
+		TextDecoder decoder(elementDefinition);
+		while (batch.size() < count)
+		{
+			const auto text = m_lineReader->lines();
+			m_lineReader->skip(decoder.decode(text.begin(), text.end(), count, batch) - text.begin());
+			if (text.begin() == text.end() && batch.size() < count)
+			{
+				throw std::runtime_error("Unexpected end of file.");
+			}
+		}
+	}
+	for (std::size_t i = batch.size(); i < count; ++i)
+	{
+		readBinaryElement(elementDefinition, batch);
+	}
+}
+
+ElementCursor FileParser::cursor(const std::string& elementName, std::size_t batchSize)
+{
+	if (batchSize == 0)
+	{
+		throw std::invalid_argument("Batch size must be greater than zero.");
+	}
+	const auto& element = elementDefinition(elementName);
+	return ElementCursor(*this, &element - m_elements.data(), batchSize);
+}
+
+bool FileParser::next(ElementCursor& cursor, ElementBatch& batch)
+{
+	const auto& elementDefinition = m_elements[cursor.m_element];
+	if (cursor.m_next == elementDefinition.size)
+	{
+		return false;
+	}
+	if (cursor.m_offset < 0)
+	{
+		cursor.m_offset = sectionOffset(cursor.m_element);
+	}
+	if (&batch != cursor.m_batch)
+	{
+		batch = ElementBatch(elementDefinition, cursor.m_batchSize);
+		cursor.m_batch = &batch;
+	}
+
+	LIBPLYXX_STATISTICS_ONLY(StatisticsScope statistics(m_statistics, &m_statisticsMutex, &Statistics::bytesRead);)
+	// Other cursors and reads may have moved the reader since the last call.
+	m_lineReader->seek(cursor.m_offset);
+	const std::size_t count = std::min(cursor.m_batchSize, elementDefinition.size - cursor.m_next);
+	batch.clear(cursor.m_next);
+	readBatch(elementDefinition, count, batch);
+	cursor.m_next += count;
+#ifdef LIBPLYXX_STATISTICS
+	if (m_data)
+	{
+		countBytes(m_lineReader->tell() - cursor.m_offset);
+	}
+#endif
+	LIBPLYXX_STATISTICS_ONLY(countBatch(cursor.m_element, batch);)
+	cursor.m_offset = m_lineReader->tell();
+	return true;
+}
+
+std::streamsize FileParser::sectionOffset(std::size_t element)
+{
+	if (!m_index.sections.empty() && !m_index.sections[element].empty())
+	{
+		return static_cast<std::streamsize>(m_index.sections[element].front());
+	}
+	m_lineReader->seek(m_dataOffset);
+	for (std::size_t e = 0; e < element; ++e)
+	{
+		skipElements(m_elements[e], m_elements[e].size);
+	}
+	return m_lineReader->tell();
+}
+
+ElementCursor::ElementCursor(FileParser& parser, std::size_t element, std::size_t batchSize)
+	: m_parser(&parser), m_element(element), m_batchSize(batchSize), m_next(0), m_offset(-1), m_batch(nullptr)
+{
+}
+
+bool ElementCursor::next(ElementBatch& batch)
+{
+	return m_parser->next(*this, batch);
+}
+
+ElementCursor File::cursor(const std::string& elementName, std::size_t batchSize)
+{
+	return m_parser->cursor(elementName, batchSize);
+}
+
+void FileParser::deliver(const ElementDefinition& elementDefinition, ElementHandler& handler, ElementBatch& batch) const
+{
+	LIBPLYXX_STATISTICS_ONLY(countBatch(&elementDefinition - m_elements.data(), batch);)
+	LIBPLYXX_STATISTICS_ONLY(PhaseTimer timer(&StatisticsCounters::callback);)
+	if (handler.batchCallback)
+	{
+		(*handler.batchCallback)(batch);
+	}
+	else if (handler.reader)
+	{
+		handler.reader->readBatch(batch);
+	}
+	else if (handler.listTarget)
+	{
+		const auto offsets = batch.listOffsets();
+		const std::size_t typeSize = batch.typeSize(0);
+		for (std::size_t i = 0; i < batch.size(); ++i)
+		{
+			const std::size_t length = offsets[i + 1] - offsets[i];
+			std::memcpy(handler.listTarget->appendLists(1, length), batch.columnData(0) + offsets[i] * typeSize, length * typeSize);
+		}
+	}
+	else
+	{
+		ElementBuffer buffer(elementDefinition);
+		for (std::size_t i = 0; i < batch.size(); ++i)
+		{
+			copyElement(batch, i, buffer);
+			(*handler.elementCallback)(buffer);
+		}
+	}
+}
+
+void FileParser::decodeParallel(ThreadPool& pool, std::size_t taskCount, const DecodeTask& decode, std::vector<ElementHandler>& handlers)
+{
+	std::deque<std::future<void>> pending;
+	try
+	{
+		// List targets are appended to, they need the file order.
+		const bool fileOrder = std::any_of(handlers.begin(), handlers.end(), [](const ElementHandler& h) { return h.listTarget != nullptr; });
+		if (m_deliveryOrder == File::DeliveryOrder::UNORDERED && !fileOrder)
+		{
+			// Readers keep state across batches, they get them one at a time (in any order).
+			std::mutex readerMutex;
+			BatchSink sink = [this, &handlers, &readerMutex](std::size_t element, ElementBatch& batch)
+			{
+				std::unique_lock<std::mutex> lock;
+				if (handlers[element].reader)
+				{
+					lock = std::unique_lock<std::mutex>(readerMutex);
+				}
+				deliver(m_elements[element], handlers[element], batch);
+			};
+			for (std::size_t task = 0; task < taskCount; ++task)
+			{
+				pending.push_back(pool.submit([this, &decode, &sink, task]()
+				{
+					LIBPLYXX_STATISTICS_ONLY(StatisticsScope statistics(m_statistics, &m_statisticsMutex, &Statistics::bytesRead);)
+					decode(task, sink);
+				}));
+			}
+			waitAll(pending);
+			return;
+		}
+
+		// Tasks are decoded ahead of delivery within a bounded window, and delivered in task order.
+		struct DecodedBatch
+		{
+			std::size_t element;
+			ElementBatch batch;
+		};
+		std::vector<std::vector<DecodedBatch>> results(taskCount);
+		auto submit = [this, &pool, &decode, &results](std::size_t task)
+		{
+			return pool.submit([this, &decode, &results, task]()
+			{
+				LIBPLYXX_STATISTICS_ONLY(StatisticsScope statistics(m_statistics, &m_statisticsMutex, &Statistics::bytesRead);)
+				BatchSink sink = [&results, task](std::size_t element, ElementBatch& batch)
+				{
+					results[task].push_back(DecodedBatch{ element, std::move(batch) });
+				};
+				decode(task, sink);
+			});
+		};
+
+		const std::size_t window = 2 * pool.size();
+		std::size_t next = 0;
+		for (; next < std::min(window, taskCount); ++next)
+		{
+			pending.push_back(submit(next));
+		}
+		for (std::size_t task = 0; task < taskCount; ++task)
+		{
+			// Out of the queue first, a consumed future cannot be waited for when unwinding.
+			std::future<void> done = std::move(pending.front());
+			pending.pop_front();
+			done.get();
+			if (next < taskCount)
+			{
+				pending.push_back(submit(next++));
+			}
+			for (auto& decoded : results[task])
+			{
+				deliver(m_elements[decoded.element], handlers[decoded.element], decoded.batch);
+			}
+			std::vector<DecodedBatch>().swap(results[task]);
+		}
+	}
+	catch (...)
+	{
+		// Running tasks refer to this frame, let them complete before unwinding.
+		for (auto& f : pending)
+		{
+			if (f.valid())
+			{
+				f.wait();
+			}
+		}
+		throw;
+	}
+}
+
+void FileParser::readTextParallel(ThreadPool& pool, std::vector<ElementHandler>& handlers)
+{
+	const char* begin = m_data + m_dataOffset;
+	const char* end = m_data + m_size;
+
+	// Split the data in chunks of whole lines, several per thread to balance the load.
+	const std::size_t MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+	const std::size_t dataSize = end - begin;
+	const std::size_t chunkCount = std::max<std::size_t>(4 * pool.size(), dataSize / MAX_CHUNK_SIZE + 1);
+	std::vector<const char*> bounds{ begin };
+	for (std::size_t i = 1; i < chunkCount; ++i)
+	{
+		const char* split = std::max(begin + dataSize / chunkCount * i, bounds.back());
+		const char* eol = textio::findSIMD(split, end, '\n');
+		if (eol != end && eol + 1 != bounds.back())
+		{
+			bounds.push_back(eol + 1);
+		}
+	}
+	bounds.push_back(end);
+	const std::size_t taskCount = bounds.size() - 1;
+
+	// Count the lines of each chunk to find the first element it holds.
+	std::vector<std::size_t> firstLines(taskCount + 1, 0);
+	std::deque<std::future<void>> counts;
+	for (std::size_t task = 0; task < taskCount; ++task)
+	{
+		counts.push_back(pool.submit([&bounds, &firstLines, task]()
+		{
+			firstLines[task + 1] = textio::count(bounds[task], bounds[task + 1], '\n');
+		}));
+	}
+	waitAll(counts);
+	for (std::size_t task = 0; task < taskCount; ++task)
+	{
+		firstLines[task + 1] += firstLines[task];
+	}
+
+	DecodeTask decode = [this, &bounds, &firstLines, &handlers](std::size_t task, const BatchSink& sink)
+	{
+		parseTextChunk(bounds[task], bounds[task + 1], firstLines[task], handlers, sink);
+	};
+	decodeParallel(pool, taskCount, decode, handlers);
+}
+
+void FileParser::readBinaryParallel(ThreadPool& pool, std::size_t element, std::vector<ElementHandler>& handlers)
+{
+	// Every element has the same size, so the section is split in ranges decoded independently.
+	const auto& elementDefinition = m_elements[element];
+	const std::size_t stride = elementDefinition.binaryStride();
+	const std::size_t sectionSize = elementDefinition.size * stride;
+	const char* rows = peekOrThrow(*m_lineReader, sectionSize);
+
+	const std::size_t MAX_RANGE_SIZE = 16 * 1024 * 1024;
+	const std::size_t rangeCount = std::max<std::size_t>(4 * pool.size(), sectionSize / MAX_RANGE_SIZE + 1);
+	const std::size_t rangeRows = (elementDefinition.size + rangeCount - 1) / rangeCount;
+	const std::size_t taskCount = (elementDefinition.size + rangeRows - 1) / rangeRows;
+	const std::size_t batchSize = handlers[element].batchSize;
+
+	const bool swapBytes = m_swapBytes;
+	DecodeTask decode = [&elementDefinition, element, rows, stride, rangeRows, batchSize, swapBytes](std::size_t task, const BatchSink& sink)
+	{
+		const std::size_t first = task * rangeRows;
+		const std::size_t last = std::min(first + rangeRows, elementDefinition.size);
+		for (std::size_t index = first; index < last; index += batchSize)
+		{
+			const std::size_t count = std::min(batchSize, last - index);
+			ElementBatch batch(elementDefinition, count);
+			batch.clear(index);
+			decodeRows(rows + index * stride, count, elementDefinition, batch, swapBytes);
+			sink(element, batch);
+		}
+	};
+	decodeParallel(pool, taskCount, decode, handlers);
+	m_lineReader->skip(sectionSize);
+}
+
+void FileParser::parseTextChunk(const char* begin, const char* end, std::size_t line, const std::vector<ElementHandler>& handlers, const BatchSink& sink) const
+{
+	std::vector<TextDecoder> decoders;
+	for (const auto& elementDefinition : m_elements)
+	{
+		decoders.emplace_back(elementDefinition);
+	}
+	ElementBatch batch;
+	bool batchOpen = false;
+	std::size_t element = 0;
+	while (begin < end)
+	{
+		// Move to the element definition holding this line, the startLine of the next one.
+		while (element < m_elements.size() && line >= m_elements[element].startLine + m_elements[element].size)
+		{
+			if (batchOpen)
+			{
+				sink(element, batch);
+				batchOpen = false;
+			}
+			++element;
+		}
+		if (element == m_elements.size())
+		{
+			// Lines past the last element.
+			break;
+		}
+
+		const auto& elementDefinition = m_elements[element];
+		std::size_t remaining = elementDefinition.startLine + elementDefinition.size - line;
+		if (handlers[element].skip)
+		{
+			const std::size_t sectionLines = remaining;
+			begin = textio::skipLines(begin, end, remaining);
+			line += sectionLines - remaining;
+			if (remaining != 0 && begin != end)
+			{
+				// Last line of the data, without newline.
+				begin = end;
+				++line;
+			}
+			continue;
+		}
+		if (!batchOpen)
+		{
+			batch = ElementBatch(elementDefinition, handlers[element].batchSize);
+			batch.clear(line - elementDefinition.startLine);
+			batchOpen = true;
+		}
+
+		// The lines of the section up to the end of the batch are decoded in one run.
+		const std::size_t previousSize = batch.size();
+		const std::size_t count = previousSize + std::min(remaining, handlers[element].batchSize - previousSize);
+		begin = decoders[element].decode(begin, end, count, batch);
+		line += batch.size() - previousSize;
+
+		if (batch.size() == handlers[element].batchSize)
+		{
+			sink(element, batch);
+			batchOpen = false;
+		}
+	}
+	if (batchOpen)
+	{
+		sink(element, batch);
+	}
+}
+
+void FileParser::readElementRows(const ElementDefinition& elementDefinition, IElementReader& reader)
+{
+	// Hand over the rows by large blocks, which keeps the work buffer bounded when streaming.
+	const std::size_t ROW_BLOCK_SIZE = 1 * 1024 * 1024;
+	const std::size_t stride = elementDefinition.binaryStride();
+	const std::size_t blockRows = std::max<std::size_t>(1, ROW_BLOCK_SIZE / stride);
+	for (std::size_t first = 0; first < elementDefinition.size; first += blockRows)
+	{
+		const std::size_t count = std::min(blockRows, elementDefinition.size - first);
+		const char* rows = peekOrThrow(*m_lineReader, count * stride);
+		LIBPLYXX_STATISTICS_ONLY(countElements(&elementDefinition - m_elements.data(), count, count * elementDefinition.properties.size());)
+		{
+			LIBPLYXX_STATISTICS_ONLY(PhaseTimer timer(&StatisticsCounters::callback);)
+			reader.readRows(rows, count);
+		}
+		m_lineReader->skip(count * stride);
+	}
+}
+
+// Elements made of a list property, fixed size rows are decoded by blocks with decodeRows().
+void FileParser::readBinaryElement(const ElementDefinition& elementDefinition, ElementBuffer& elementBuffer)
+{
+	const auto& property = elementDefinition.properties.front();
+	textio::LineReader& reader = *m_lineReader;
+	assert(property.isList);
+
+	const auto lengthTypeSize = property.listLengthTypeSize;
+	size_t length = readListLength(peekOrThrow(reader, lengthTypeSize), property.listLengthType, m_swapBytes);
+	reader.skip(lengthTypeSize);
+	elementBuffer.reset(length);
+
+	// List values are contiguous in the buffer.
+	const auto size = property.typeSize;
+	if (length != 0)
+	{
+		std::memcpy(elementBuffer.data(0), peekOrThrow(reader, length * size), length * size);
+		if (m_swapBytes)
+		{
+			swapByteOrder(elementBuffer.data(0), length, size);
+		}
+		reader.skip(length * size);
+	}
+}
+
+void FileParser::readBinaryElement(const ElementDefinition& elementDefinition, ElementBatch& batch)
+{
+	const auto& property = elementDefinition.properties.front();
+	textio::LineReader& reader = *m_lineReader;
+	assert(property.isList);
+
+	const auto lengthTypeSize = property.listLengthTypeSize;
+	size_t length = readListLength(peekOrThrow(reader, lengthTypeSize), property.listLengthType, m_swapBytes);
+	reader.skip(lengthTypeSize);
+
+	const auto size = property.typeSize;
+	char* values = batch.appendList(length);
+	std::memcpy(values, peekOrThrow(reader, length * size), length * size);
+	if (m_swapBytes)
+	{
+		swapByteOrder(values, length, size);
+	}
+	reader.skip(length * size);
+}
+
+template<std::size_t N>
+void gatherColumn(char* column, const char* rows, std::size_t stride, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		std::memcpy(column + i * N, rows + i * stride, N);
+	}
+}
+
+void FileParser::decodeRows(const char* rows, std::size_t count, const ElementDefinition& elementDefinition, ElementBatch& batch, bool swapBytes)
+{
+	const std::size_t stride = elementDefinition.binaryStride();
+	std::size_t offset = 0;
+	for (std::size_t p = 0, c = 0; p < elementDefinition.properties.size(); ++p)
+	{
+		if (!elementDefinition.properties[p].selected)
+		{
+			offset += elementDefinition.properties[p].typeSize;
+			continue;
+		}
+		char* column = batch.value(c++, batch.size());
+		const char* source = rows + offset;
+		switch (elementDefinition.properties[p].typeSize)
+		{
+		case 1: gatherColumn<1>(column, source, stride, count); break;
+		case 2: gatherColumn<2>(column, source, stride, count); break;
+		case 4: gatherColumn<4>(column, source, stride, count); break;
+		case 8: gatherColumn<8>(column, source, stride, count); break;
+		}
+		if (swapBytes)
+		{
+			swapByteOrder(column, count, elementDefinition.properties[p].typeSize);
+		}
+		offset += elementDefinition.properties[p].typeSize;
+	}
+	batch.m_size += count;
+}
+
+void FileParser::readListColumn(const ElementDefinition& elementDefinition, ListColumn& target)
+{
+	// Lists of the same length in a row, all of them for a triangle or quad mesh, are fixed size rows
+	// copied by blocks. The lengths are compared in their raw bytes.
+	const std::size_t ROW_BLOCK_SIZE = 1 * 1024 * 1024;
+	const auto& property = elementDefinition.properties.front();
+	const std::size_t lengthTypeSize = property.listLengthTypeSize;
+	const std::size_t typeSize = property.typeSize;
+	textio::LineReader& reader = *m_lineReader;
+	std::size_t remaining = elementDefinition.size;
+	while (remaining != 0)
+	{
+		const std::size_t length = readListLength(peekOrThrow(reader, lengthTypeSize), property.listLengthType, m_swapBytes);
+		const std::size_t listSize = length * typeSize;
+		const std::size_t stride = lengthTypeSize + listSize;
+		if (target.size() == 0)
+		{
+			target.reserve(elementDefinition.size * length);
+		}
+
+		// Shorter lists near the end of the data may leave less than a block of this stride.
+		std::size_t count = std::min(remaining, std::max<std::size_t>(1, ROW_BLOCK_SIZE / stride));
+		const char* rows = reader.peek(count * stride);
+		while (rows == nullptr && count > 1)
+		{
+			count /= 2;
+			rows = reader.peek(count * stride);
+		}
+		if (rows == nullptr)
+		{
+			rows = peekOrThrow(reader, stride);
+		}
+		std::size_t run = 1;
+		while (run < count && std::memcmp(rows + run * stride, rows, lengthTypeSize) == 0)
+		{
+			++run;
+		}
+
+		char* values = target.appendLists(run, length);
+		const char* source = rows + lengthTypeSize;
+		switch (listSize)
+		{
+		case 12: gatherColumn<12>(values, source, stride, run); break;
+		case 16: gatherColumn<16>(values, source, stride, run); break;
+		case 6: gatherColumn<6>(values, source, stride, run); break;
+		case 8: gatherColumn<8>(values, source, stride, run); break;
+		default:
+			for (std::size_t i = 0; i < run; ++i)
+			{
+				std::memcpy(values + i * listSize, source + i * stride, listSize);
+			}
+		}
+		if (m_swapBytes)
+		{
+			swapByteOrder(values, run * length, typeSize);
+		}
+		LIBPLYXX_STATISTICS_ONLY(countElements(&elementDefinition - m_elements.data(), run, run * length);)
+		reader.skip(run * stride);
+		remaining -= run;
+	}
+}
+
+void FileParser::copyElement(const ElementBatch& batch, std::size_t index, ElementBuffer& buffer)
+{
+	if (batch.isList())
+	{
+		const std::size_t begin = batch.m_listOffsets[index];
+		const std::size_t length = batch.m_listOffsets[index + 1] - begin;
+		buffer.reset(length);
+		if (length != 0)
+		{
+			const std::size_t typeSize = batch.typeSize(0);
+			std::memcpy(buffer.data(0), batch.columnData(0) + begin * typeSize, length * typeSize);
+		}
+	}
+	else
+	{
+		for (std::size_t p = 0; p < batch.propertyCount(); ++p)
+		{
+			const std::size_t typeSize = batch.typeSize(p);
+			std::memcpy(buffer.data(p), batch.columnData(p) + index * typeSize, typeSize);
+		}
+	}
+}
+
+ElementBatch::ElementBatch(const ElementDefinition& definition, std::size_t capacity)
+	: m_isList(false), m_size(0), m_firstIndex(0)
+{
+	const std::size_t WORD_SIZE = sizeof(std::uint64_t);
+	for (const auto& p : definition.properties)
+	{
+		if (!p.selected)
+		{
+			continue;
+		}
+		m_isList = m_isList || p.isList;
+		Column column{ p.type, p.typeSize, {} };
+		// List columns grow with the data, scalar columns hold exactly one value per element.
+		if (!p.isList)
+		{
+			column.storage.resize((capacity * p.typeSize + WORD_SIZE - 1) / WORD_SIZE);
+		}
+		m_columns.push_back(std::move(column));
+	}
+	m_listOffsets.reserve(capacity + 1);
+	m_listOffsets.push_back(0);
+}
+
+ListColumn::ListColumn()
+	: m_type(Type::INT), m_typeSize(TYPE_SIZE_MAP.at(Type::INT)), m_size(0), m_width(0), m_offsets{ 0 }
+{
+}
+
+Span<const std::size_t> ListColumn::offsets() const
+{
+	return m_width != 0 ? Span<const std::size_t>() : Span<const std::size_t>(m_offsets.data(), m_offsets.size());
+}
+
+void ListColumn::reset(Type type)
+{
+	m_type = type;
+	m_typeSize = TYPE_SIZE_MAP.at(type);
+	m_size = 0;
+	m_width = 0;
+	m_offsets.assign(1, 0);
+}
+
+void ListColumn::reserve(std::size_t valueCount)
+{
+	const std::size_t requiredWords = (valueCount * m_typeSize + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+	if (m_storage.size() < requiredWords)
+	{
+		m_storage.resize(std::max(requiredWords, 2 * m_storage.size()));
+		LIBPLYXX_STATISTICS_ONLY(countBufferAllocation();)
+	}
+}
+
+char* ListColumn::appendLists(std::size_t count, std::size_t length)
+{
+	if (m_size == 0 && length != 0)
+	{
+		m_width = length;
+		m_offsets.clear();
+	}
+	else if (m_width != 0 && length != m_width)
+	{
+		// Lengths differ from now on, back to explicit offsets.
+		m_offsets.resize(m_size + 1);
+		for (std::size_t i = 0; i <= m_size; ++i)
+		{
+			m_offsets[i] = i * m_width;
+		}
+		m_width = 0;
+	}
+
+	const std::size_t begin = valueCount();
+	reserve(begin + count * length);
+	if (m_width == 0)
+	{
+		for (std::size_t i = 1; i <= count; ++i)
+		{
+			m_offsets.push_back(begin + i * length);
+		}
+	}
+	m_size += count;
+	return reinterpret_cast<char*>(m_storage.data()) + begin * m_typeSize;
+}
+
+Span<const std::size_t> ElementBatch::listOffsets() const
+{
+	return Span<const std::size_t>(m_listOffsets.data(), m_isList ? m_size + 1 : 0);
+}
+
+void ElementBatch::clear(std::size_t firstIndex)
+{
+	m_size = 0;
+	m_firstIndex = firstIndex;
+	m_listOffsets.resize(1);
+}
+
+char* ElementBatch::appendList(std::size_t length)
+{
+	auto& column = m_columns.front();
+	const std::size_t begin = m_listOffsets.back();
+	const std::size_t end = begin + length;
+	const std::size_t requiredWords = (end * column.typeSize + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+	if (column.storage.size() < requiredWords)
+	{
+		column.storage.resize(std::max(requiredWords, 2 * column.storage.size()));
+		LIBPLYXX_STATISTICS_ONLY(countBufferAllocation();)
+	}
+	m_listOffsets.push_back(end);
+	++m_size;
+	return column.data() + begin * column.typeSize;
+}
+
+ElementBuffer::ElementBuffer(const ElementDefinition& definition)
+	: ElementBuffer()
+{
+	auto& properties = definition.properties;
+	for (auto& p : properties)
+	{
+		if (!p.selected)
+		{
+			continue;
+		}
+		if (p.isList)
+		{
+			appendListProperty(p.type);
+		}
+		else
+		{
+			appendScalarProperty(p.type);
+		}
+	}
+}
+
+ElementBuffer::ElementBuffer(ElementBuffer&& other)
+	: m_isList(other.m_isList), m_listType(other.m_listType),
+	m_listStart(other.m_listStart), m_listOffset(other.m_listOffset),
+	m_types(std::move(other.m_types)), m_offsets(std::move(other.m_offsets)),
+	m_storage(std::move(other.m_storage)), m_properties(std::move(other.m_properties))
+{
+	rebindProperties();
+}
+
+ElementBuffer& ElementBuffer::operator=(ElementBuffer&& other)
+{
+	m_isList = other.m_isList;
+	m_listType = other.m_listType;
+	m_listStart = other.m_listStart;
+	m_listOffset = other.m_listOffset;
+	m_types = std::move(other.m_types);
+	m_offsets = std::move(other.m_offsets);
+	m_storage = std::move(other.m_storage);
+	m_properties = std::move(other.m_properties);
+	rebindProperties();
+	return *this;
+}
+
+void ElementBuffer::reset(size_t size)
+{
+	if (size == m_types.size())
+	{
+		return;
+	}
+	if (!m_isList || size < m_listStart)
+	{
+		throw std::logic_error("Cannot resize an element without list property.");
+	}
+
+	// List values follow each other, so only the slots past the current size need an offset.
+	const std::size_t typeSize = TYPE_SIZE_MAP.at(m_listType);
+	const std::size_t previousSize = m_types.size();
+	m_types.resize(size, m_listType);
+	m_offsets.resize(size);
+	for (std::size_t i = previousSize; i < size; ++i)
+	{
+		m_offsets[i] = m_listOffset + (i - m_listStart) * typeSize;
+	}
+	resizeStorage(m_listOffset + (size - m_listStart) * typeSize);
+	while (m_properties.size() < size)
+	{
+		m_properties.emplace_back(this, m_properties.size());
+	}
+}
+
+std::size_t alignOffset(std::size_t offset, std::size_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+void ElementBuffer::appendScalarProperty(Type type)
+{
+	const std::size_t typeSize = TYPE_SIZE_MAP.at(type);
+	const std::size_t end = m_types.empty() ? 0 : m_offsets.back() + TYPE_SIZE_MAP.at(m_types.back());
+	const std::size_t offset = alignOffset(end, typeSize);
+	m_types.push_back(type);
+	m_offsets.push_back(offset);
+	resizeStorage(offset + typeSize);
+	m_properties.emplace_back(this, m_properties.size());
+}
+
+void ElementBuffer::appendListProperty(Type type)
+{
+	m_isList = true;
+	m_listType = type;
+	m_listStart = m_types.size();
+	const std::size_t end = m_types.empty() ? 0 : m_offsets.back() + TYPE_SIZE_MAP.at(m_types.back());
+	m_listOffset = alignOffset(end, TYPE_SIZE_MAP.at(type));
+}
+
+void ElementBuffer::resizeStorage(std::size_t byteSize)
+{
+	const std::size_t words = (byteSize + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+	if (m_storage.size() < words)
+	{
+		m_storage.resize(std::max(words, 2 * m_storage.size()));
+		LIBPLYXX_STATISTICS_ONLY(countBufferAllocation();)
+	}
+}
+
+void ElementBuffer::rebindProperties()
+{
+	for (auto& p : m_properties)
+	{
+		p.m_buffer = this;
 	}
-	file << "end_header" << std::endl;
+}
 
-	file.close();
+std::string formatString(File::Format format)
+{
+	switch (format)
+	{
+	case File::Format::ASCII: return "ascii";
+	case File::Format::BINARY_BIG_ENDIAN: return "binary_big_endian";
+	case File::Format::BINARY_LITTLE_ENDIAN: return "binary_little_endian";
+	}
+	return "";
 }
 
-void FileOut::writeData()
+std::string typeString(Type type)
+{
+	switch (type)
+	{
+	case Type::CHAR: return "char";
+	case Type::UCHAR: return "uchar";
+	case Type::SHORT: return "short";
+	case Type::USHORT: return "ushort";
+	case Type::INT: return "int";
+	case Type::UINT: return "uint";
+	case Type::FLOAT: return "float";
+	case Type::DOUBLE: return "double";
+	}
+	return "";
+}
+
+void writePropertyDefinition(std::string& header, const Property& propertyDefinition)
+{
+	if (propertyDefinition.isList)
+	{
+		header += "property list uchar ";
+	}
+	else
+	{
+		header += "property ";
+	}
+	header += typeString(propertyDefinition.type) + " " + propertyDefinition.name + '\n';
+}
+
+void writeElementDefinition(std::string& header, const Element& elementDefinition)
+{
+	header += "element " + elementDefinition.name + " " + std::to_string(elementDefinition.size) + '\n';
+	for (const auto& prop : elementDefinition.properties)
+	{
+		writePropertyDefinition(header, prop);
+	}
+}
+
+void writeTextProperties(fileio::OutputFile& file, ElementBuffer& buffer, const ElementDefinition& elementDefinition, int decimals)
+{
+	// Longest text of one value and its separator.
+	const std::size_t VALUE_LENGTH = textio::MAX_REAL_LENGTH + 1;
+	char* out;
+	if (elementDefinition.properties.front().isList)
+	{
+		out = textio::formatUnsigned(file.reserve(VALUE_LENGTH), buffer.size());
+		*out++ = ' ';
+		file.commit(out);
+		auto& convert = elementDefinition.properties.front().writeConvertFunction;
+		for (size_t i = 0; i < buffer.size(); ++i)
+		{
+			out = convert(buffer.data(i), file.reserve(VALUE_LENGTH), decimals);
+			*out++ = ' ';
+			file.commit(out);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < buffer.size(); ++i)
+		{
+			auto& convert = elementDefinition.properties.at(i).writeConvertFunction;
+			out = convert(buffer.data(i), file.reserve(VALUE_LENGTH), decimals);
+			*out++ = ' ';
+			file.commit(out);
+		}
+	}
+	out = file.reserve(1);
+	*out++ = '\n';
+	file.commit(out);
+}
+
+// Consecutive properties of the same size are swapped together.
+void swapRowByteOrder(char* row, const ElementDefinition& elementDefinition)
+{
+	const auto& properties = elementDefinition.properties;
+	for (std::size_t p = 0; p < properties.size();)
+	{
+		const std::size_t size = properties[p].typeSize;
+		std::size_t count = 1;
+		while (p + count < properties.size() && properties[p + count].typeSize == size)
+		{
+			++count;
+		}
+		swapByteOrder(row, count, size);
+		row += count * size;
+		p += count;
+	}
+}
+
+void writeBinaryProperties(fileio::OutputFile& file, ElementBuffer& buffer, const ElementDefinition& elementDefinition, bool swapBytes)
+{
+	if (elementDefinition.properties.front().isList)
+	{
+		// List values are contiguous in the buffer.
+		const std::size_t typeSize = elementDefinition.properties.front().typeSize;
+		const std::size_t size = buffer.size() * typeSize;
+		char* out = file.reserve(1 + size);
+		*out++ = static_cast<char>(static_cast<unsigned char>(buffer.size()));
+		if (size != 0)
+		{
+			std::memcpy(out, buffer.data(0), size);
+			if (swapBytes)
+			{
+				swapByteOrder(out, buffer.size(), typeSize);
+			}
+		}
+		file.commit(out + size);
+	}
+	else
+	{
+		char* out = file.reserve(elementDefinition.binaryStride());
+		char* row = out;
+		for (size_t i = 0; i < buffer.size(); ++i)
+		{
+			const std::size_t size = elementDefinition.properties[i].typeSize;
+			std::memcpy(out, buffer.data(i), size);
+			out += size;
+		}
+		if (swapBytes)
+		{
+			swapRowByteOrder(row, elementDefinition);
+		}
+		file.commit(out);
+	}
+}
+
+// Returns the number of values written.
+std::uint64_t writeElements(fileio::OutputFile& file, const Element& elementDefinition, File::Format format, ElementWriteCallback& callback, int decimals)
+{
+	const size_t size = elementDefinition.size;
+	const ElementDefinition definition(elementDefinition);
+	ElementBuffer buffer(definition);
+	buffer.reset(elementDefinition.properties.size());
+	std::uint64_t values = 0;
+	if (format == File::Format::ASCII)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			{
+				LIBPLYXX_STATISTICS_ONLY(PhaseTimer timer(&StatisticsCounters::callback);)
+				callback(buffer, i);
+			}
+			writeTextProperties(file, buffer, definition, decimals);
+			values += buffer.size();
+		}
+	}
+	else
+	{
+		const bool swapBytes = !isHostByteOrder(format);
+		for (size_t i = 0; i < size; ++i)
+		{
+			{
+				LIBPLYXX_STATISTICS_ONLY(PhaseTimer timer(&StatisticsCounters::callback);)
+				callback(buffer, i);
+			}
+			writeBinaryProperties(file, buffer, definition, swapBytes);
+			values += buffer.size();
+		}
+	}
+	return values;
+}
+
+template<std::size_t N>
+void copyStrided(char* dest, std::size_t destStride, const char* source, std::size_t sourceStride, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		std::memcpy(dest + i * destStride, source + i * sourceStride, N);
+	}
+}
+
+void copyStrided(char* dest, std::size_t destStride, const char* source, std::size_t sourceStride, std::size_t count, std::size_t typeSize)
+{
+	switch (typeSize)
+	{
+	case 1: copyStrided<1>(dest, destStride, source, sourceStride, count); break;
+	case 2: copyStrided<2>(dest, destStride, source, sourceStride, count); break;
+	case 4: copyStrided<4>(dest, destStride, source, sourceStride, count); break;
+	case 8: copyStrided<8>(dest, destStride, source, sourceStride, count); break;
+	}
+}
+
+void convertValue(char* dest, Type destType, const char* source, Type sourceType)
+{
+	writeScalar<double>(dest, destType, readScalar<double>(source, sourceType));
+}
+
+std::size_t readOffset(const PropertyArray& array, std::size_t index)
+{
+	const char* p = array.offsets + index * array.offsetSize;
+	switch (array.offsetSize)
+	{
+	case 1: return *reinterpret_cast<const unsigned char*>(p);
+	case 2: { std::uint16_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+	case 4: { std::uint32_t v; std::memcpy(&v, p, sizeof(v)); return v; }
+	default: { std::uint64_t v; std::memcpy(&v, p, sizeof(v)); return static_cast<std::size_t>(v); }
+	}
+}
+
+void checkElementArrays(const ElementDefinition& elementDefinition, const ElementArrays& arrays)
+{
+	bool valid = arrays.size() == elementDefinition.properties.size();
+	for (std::size_t p = 0; valid && p < arrays.size(); ++p)
+	{
+		valid = (arrays[p].offsets != nullptr) == elementDefinition.properties[p].isList;
+	}
+	if (!valid)
+	{
+		throw std::runtime_error("Element arrays do not match the element definition.");
+	}
+}
+
+// True when the arrays are the members of one array of structs laid out as the rows of the file.
+bool matchesFileLayout(const ElementDefinition& elementDefinition, const ElementArrays& arrays)
+{
+	const std::size_t stride = elementDefinition.binaryStride();
+	std::size_t offset = 0;
+	for (std::size_t p = 0; p < arrays.size(); ++p)
+	{
+		if (arrays[p].type != elementDefinition.properties[p].type || arrays[p].stride != stride || arrays[p].data != arrays[0].data + offset)
+		{
+			return false;
+		}
+		offset += elementDefinition.properties[p].typeSize;
+	}
+	return true;
+}
+
+// Fixed size elements, interleaved by blocks of rows directly in the output buffer.
+void writeBinaryRows(fileio::OutputFile& file, const ElementDefinition& elementDefinition, const ElementArrays& arrays, bool swapBytes)
+{
+	const std::size_t stride = elementDefinition.binaryStride();
+	if (!swapBytes && matchesFileLayout(elementDefinition, arrays))
+	{
+		file.write(arrays[0].data, elementDefinition.size * stride);
+		return;
+	}
+
+	bool sameTypeSize = true;
+	for (const auto& property : elementDefinition.properties)
+	{
+		sameTypeSize = sameTypeSize && property.typeSize == elementDefinition.properties.front().typeSize;
+	}
+	const std::size_t BLOCK_SIZE = 1 << 16;
+	const std::size_t blockRows = std::max<std::size_t>(1, BLOCK_SIZE / stride);
+	// With mixed type sizes, each column of a block is swapped contiguously before being interleaved.
+	const bool swapColumns = swapBytes && !sameTypeSize;
+	std::vector<char> column(swapColumns ? blockRows * sizeof(std::uint64_t) : 0);
+	for (std::size_t first = 0; first < elementDefinition.size; first += blockRows)
+	{
+		const std::size_t count = std::min(blockRows, elementDefinition.size - first);
+		char* out = file.reserve(count * stride);
+		std::size_t offset = 0;
+		for (std::size_t p = 0; p < arrays.size(); ++p)
+		{
+			const auto& array = arrays[p];
+			const auto& property = elementDefinition.properties[p];
+			const char* source = array.data + first * array.stride;
+			char* dest = swapColumns ? column.data() : out + offset;
+			const std::size_t destStride = swapColumns ? property.typeSize : stride;
+			if (array.type == property.type)
+			{
+				copyStrided(dest, destStride, source, array.stride, count, property.typeSize);
+			}
+			else
+			{
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					convertValue(dest + i * destStride, property.type, source + i * array.stride, array.type);
+				}
+			}
+			if (swapColumns)
+			{
+				swapByteOrder(column.data(), count, property.typeSize);
+				copyStrided(out + offset, stride, column.data(), property.typeSize, count, property.typeSize);
+			}
+			offset += property.typeSize;
+		}
+		if (swapBytes && sameTypeSize)
+		{
+			swapByteOrder(out, count * arrays.size(), elementDefinition.properties.front().typeSize);
+		}
+		file.commit(out + count * stride);
+	}
+}
+
+// Elements holding lists, one element at a time.
+void writeBinaryListElements(fileio::OutputFile& file, const ElementDefinition& elementDefinition, const ElementArrays& arrays, bool swapBytes)
+{
+	for (std::size_t i = 0; i < elementDefinition.size; ++i)
+	{
+		for (std::size_t p = 0; p < arrays.size(); ++p)
+		{
+			const auto& array = arrays[p];
+			const auto& property = elementDefinition.properties[p];
+			if (!property.isList)
+			{
+				char* out = file.reserve(property.typeSize);
+				if (array.type == property.type)
+				{
+					std::memcpy(out, array.data + i * array.stride, property.typeSize);
+				}
+				else
+				{
+					convertValue(out, property.type, array.data + i * array.stride, array.type);
+				}
+				if (swapBytes)
+				{
+					swapByteOrder(out, 1, property.typeSize);
+				}
+				file.commit(out + property.typeSize);
+				continue;
+			}
+
+			const std::size_t begin = readOffset(array, i);
+			const std::size_t length = readOffset(array, i + 1) - begin;
+			char* out = file.reserve(property.listLengthTypeSize + length * property.typeSize);
+			writeScalar(out, property.listLengthType, length);
+			if (readScalar<std::size_t>(out, property.listLengthType) != length)
+			{
+				throw std::runtime_error("List too long for its length type.");
+			}
+			if (swapBytes)
+			{
+				swapByteOrder(out, 1, property.listLengthTypeSize);
+			}
+			out += property.listLengthTypeSize;
+			const char* source = array.data + begin * array.stride;
+			if (array.type == property.type)
+			{
+				std::memcpy(out, source, length * property.typeSize);
+			}
+			else
+			{
+				for (std::size_t v = 0; v < length; ++v)
+				{
+					convertValue(out + v * property.typeSize, property.type, source + v * array.stride, array.type);
+				}
+			}
+			if (swapBytes)
+			{
+				swapByteOrder(out, length, property.typeSize);
+			}
+			file.commit(out + length * property.typeSize);
+		}
+	}
+}
+
+void writeTextValue(fileio::OutputFile& file, const PropertyDefinition& property, const char* value, Type type, int decimals)
+{
+	char converted[sizeof(std::uint64_t)];
+	if (type != property.type)
+	{
+		convertValue(converted, property.type, value, type);
+		value = converted;
+	}
+	char* out = property.writeConvertFunction(value, file.reserve(textio::MAX_REAL_LENGTH + 1), decimals);
+	*out++ = ' ';
+	file.commit(out);
+}
+
+void writeTextElements(fileio::OutputFile& file, const ElementDefinition& elementDefinition, const ElementArrays& arrays, int decimals)
+{
+	for (std::size_t i = 0; i < elementDefinition.size; ++i)
+	{
+		for (std::size_t p = 0; p < arrays.size(); ++p)
+		{
+			const auto& array = arrays[p];
+			const auto& property = elementDefinition.properties[p];
+			if (!property.isList)
+			{
+				writeTextValue(file, property, array.data + i * array.stride, array.type, decimals);
+				continue;
+			}
+			const std::size_t begin = readOffset(array, i);
+			const std::size_t end = readOffset(array, i + 1);
+			char* out = textio::formatUnsigned(file.reserve(textio::MAX_INTEGER_LENGTH + 1), end - begin);
+			*out++ = ' ';
+			file.commit(out);
+			for (std::size_t v = begin; v < end; ++v)
+			{
+				writeTextValue(file, property, array.data + v * array.stride, array.type, decimals);
+			}
+		}
+		char* out = file.reserve(1);
+		*out++ = '\n';
+		file.commit(out);
+	}
+}
+
+// Returns the number of values written.
+std::uint64_t writeElementArrays(fileio::OutputFile& file, const Element& element, File::Format format, const ElementArrays& arrays, int decimals)
+{
+	const ElementDefinition elementDefinition(element);
+	checkElementArrays(elementDefinition, arrays);
+	if (format == File::Format::ASCII)
+	{
+		writeTextElements(file, elementDefinition, arrays, decimals);
+	}
+	else if (elementDefinition.binaryStride() != 0)
+	{
+		writeBinaryRows(file, elementDefinition, arrays, !isHostByteOrder(format));
+	}
+	else
+	{
+		writeBinaryListElements(file, elementDefinition, arrays, !isHostByteOrder(format));
+	}
+	std::uint64_t values = 0;
+	for (const auto& array : arrays)
+	{
+		values += array.offsets ? readOffset(array, element.size) : element.size;
+	}
+	return values;
+}
+
+FileOut::FileOut(const PATH_STRING& filename, File::Format format)
+	: m_filename(filename), m_format(format), m_realPrecision(-1),
+	m_bufferSize(fileio::OutputFile::DEFAULT_BUFFER_SIZE), m_preallocate(false)
+{
+	createFile();
+	resetStatistics();
+}
+
+FileOut::~FileOut() = default;
+
+void FileOut::setElementsDefinition(const ElementsDefinition& definitions)
+{
+	m_definitions = definitions;
+	resetStatistics();
+}
+
+void FileOut::setElementWriteCallback(const std::string& elementName, ElementWriteCallback& writeCallback)
+{
+	m_writeCallbacks[elementName] = writeCallback;
+}
+
+void FileOut::setElementArrays(const std::string& elementName, const ElementArrays& arrays)
+{
+	m_elementArrays[elementName] = arrays;
+}
+
+void FileOut::setRealPrecision(int decimals)
+{
+	m_realPrecision = decimals;
+}
+
+void FileOut::setBufferSize(std::size_t bytes)
+{
+	m_bufferSize = bytes;
+	if (m_file)
+	{
+		m_file->setBufferSize(bytes);
+	}
+}
+
+void FileOut::setPreallocate(bool preallocate)
+{
+	m_preallocate = preallocate;
+}
+
+void FileOut::write()
+{
+	LIBPLYXX_STATISTICS_ONLY(StatisticsScope statistics(m_statistics, nullptr, &Statistics::bytesWritten);)
+	if (!m_file)
+	{
+		createFile();
+	}
+	const std::string header = writeHeader();
+	if (m_preallocate)
+	{
+		std::size_t size = header.size();
+		for (const auto& elem : m_definitions)
+		{
+			const std::size_t stride = ElementDefinition(elem).binaryStride();
+			if (m_format == File::Format::ASCII || stride == 0)
+			{
+				// Unknown size, lists or text.
+				size = 0;
+				break;
+			}
+			size += stride * elem.size;
+		}
+		if (size != 0)
+		{
+			m_file->preallocate(size);
+		}
+	}
+	m_file->write(header.data(), header.size());
+	writeData();
+	m_file->close();
+	m_file.reset();
+}
+
+void FileOut::resetStatistics()
 {
-	std::ofstream file(m_filename, std::ios::out | std::ios::binary | std::ios::app);
+	std::vector<std::string> names;
 	for (const auto& elem : m_definitions)
 	{
-		writeElements(file, elem, m_format, m_writeCallbacks[elem.name]);
+		names.push_back(elem.name);
+	}
+	m_statistics = emptyStatistics(names);
+}
+
+void FileOut::createFile()
+{
+	m_file.reset(new fileio::OutputFile(m_filename, m_bufferSize));
+}
+
+std::string FileOut::writeHeader()
+{
+	std::string header = "ply\nformat " + formatString(m_format) + " 1.0\n";
+	for (const auto& def : m_definitions)
+	{
+		writeElementDefinition(header, def);
+	}
+	header += "end_header\n";
+	return header;
+}
+
+void FileOut::writeData()
+{
+	for (std::size_t e = 0; e < m_definitions.size(); ++e)
+	{
+		const auto& elem = m_definitions[e];
+		const auto arrays = m_elementArrays.find(elem.name);
+		std::uint64_t values;
+		if (arrays != m_elementArrays.end())
+		{
+			values = writeElementArrays(*m_file, elem, m_format, arrays->second, m_realPrecision);
+		}
+		else
+		{
+			values = writeElements(*m_file, elem, m_format, m_writeCallbacks[elem.name], m_realPrecision);
+		}
+		LIBPLYXX_STATISTICS_ONLY(countElements(e, elem.size, values);)
+		(void)values;
 	}
-	file.close();
 }
 
 }
@@ -8,9 +8,20 @@
 #include <cassert>
 #include <memory>
 #include <functional>
+#include <iosfwd>
+#include <cstdint>
+#include <stdexcept>
+#include <cstring>
+#include <tuple>
+#include <utility>
 
 #include "textio.h"
 
+namespace fileio
+{
+	class OutputFile;
+}
+
 #ifdef _WIN32
     #define PATH_STRING std::wstring
     #define Str(s) L##s
@@ -23,22 +34,46 @@ namespace libply
 {
 	enum class Type
 	{
-		//CHAR,
+		CHAR,
 		UCHAR,
-		//SHORT,
-		//USHORT,
+		SHORT,
+		USHORT,
 		INT,
-		//UINT,
+		UINT,
 		FLOAT,
-		DOUBLE,
-		//INT8,
-		//UINT8,
-		//INT16,
-		//UINT16,
-		//INT32,
-		//UINT32,
-		//FLOAT32,
-		//FLOAT64
+		DOUBLE
+	};
+	// The sized type names (int8, uint8, ..., float64) are read as their equivalent type above.
+
+	// Maps a C++ scalar type to the PLY type with the same representation.
+	template<typename T> struct TypeOf;
+	template<> struct TypeOf<signed char> { static constexpr Type value = Type::CHAR; };
+	template<> struct TypeOf<unsigned char> { static constexpr Type value = Type::UCHAR; };
+	template<> struct TypeOf<short> { static constexpr Type value = Type::SHORT; };
+	template<> struct TypeOf<unsigned short> { static constexpr Type value = Type::USHORT; };
+	template<> struct TypeOf<int> { static constexpr Type value = Type::INT; };
+	template<> struct TypeOf<unsigned int> { static constexpr Type value = Type::UINT; };
+	template<> struct TypeOf<float> { static constexpr Type value = Type::FLOAT; };
+	template<> struct TypeOf<double> { static constexpr Type value = Type::DOUBLE; };
+
+	// Non-owning view of a contiguous array.
+	template<typename T>
+	class Span
+	{
+	public:
+		Span() : m_data(nullptr), m_size(0) {};
+		Span(T* data, std::size_t size) : m_data(data), m_size(size) {};
+
+		T* data() const { return m_data; };
+		std::size_t size() const { return m_size; };
+		bool empty() const { return m_size == 0; };
+		T& operator[](std::size_t index) const { return m_data[index]; };
+		T* begin() const { return m_data; };
+		T* end() const { return m_data + m_size; };
+
+	private:
+		T* m_data;
+		std::size_t m_size;
 	};
 
 	class IScalarProperty
@@ -92,30 +127,271 @@ namespace libply
 		InternalType m_value;
 	};
 
+	inline std::size_t typeSize(Type type)
+	{
+		switch (type)
+		{
+		case Type::CHAR: return 1;
+		case Type::UCHAR: return 1;
+		case Type::SHORT: return 2;
+		case Type::USHORT: return 2;
+		case Type::INT: return 4;
+		case Type::UINT: return 4;
+		case Type::FLOAT: return 4;
+		case Type::DOUBLE: return 8;
+		}
+		return 0;
+	}
+
+	// Whether T has the same in-memory representation as the PLY type.
+	template<typename T>
+	bool isSameRepresentation(Type type)
+	{
+		switch (type)
+		{
+		case Type::CHAR: return sizeof(T) == 1 && std::is_integral<T>::value && std::is_signed<T>::value;
+		case Type::UCHAR: return sizeof(T) == 1 && std::is_integral<T>::value && std::is_unsigned<T>::value;
+		case Type::SHORT: return sizeof(T) == 2 && std::is_integral<T>::value && std::is_signed<T>::value;
+		case Type::USHORT: return sizeof(T) == 2 && std::is_integral<T>::value && std::is_unsigned<T>::value;
+		case Type::INT: return sizeof(T) == 4 && std::is_integral<T>::value && std::is_signed<T>::value;
+		case Type::UINT: return sizeof(T) == 4 && std::is_integral<T>::value && std::is_unsigned<T>::value;
+		case Type::FLOAT: return sizeof(T) == 4 && std::is_floating_point<T>::value;
+		case Type::DOUBLE: return sizeof(T) == 8 && std::is_floating_point<T>::value;
+		}
+		return false;
+	}
+
+	// Read a value stored with the given PLY type and convert it to T.
+	template<typename T>
+	T readScalar(const char* data, Type type)
+	{
+		switch (type)
+		{
+		case Type::CHAR: { signed char v; std::memcpy(&v, data, sizeof(v)); return static_cast<T>(v); }
+		case Type::UCHAR: { unsigned char v; std::memcpy(&v, data, sizeof(v)); return static_cast<T>(v); }
+		case Type::SHORT: { short v; std::memcpy(&v, data, sizeof(v)); return static_cast<T>(v); }
+		case Type::USHORT: { unsigned short v; std::memcpy(&v, data, sizeof(v)); return static_cast<T>(v); }
+		case Type::INT: { int v; std::memcpy(&v, data, sizeof(v)); return static_cast<T>(v); }
+		case Type::UINT: { unsigned int v; std::memcpy(&v, data, sizeof(v)); return static_cast<T>(v); }
+		case Type::FLOAT: { float v; std::memcpy(&v, data, sizeof(v)); return static_cast<T>(v); }
+		case Type::DOUBLE: { double v; std::memcpy(&v, data, sizeof(v)); return static_cast<T>(v); }
+		}
+		return T();
+	}
+
+	// Convert value to the given PLY type and store it.
+	template<typename T>
+	void writeScalar(char* data, Type type, T value)
+	{
+		switch (type)
+		{
+		case Type::CHAR: { auto v = static_cast<signed char>(value); std::memcpy(data, &v, sizeof(v)); break; }
+		case Type::UCHAR: { auto v = static_cast<unsigned char>(value); std::memcpy(data, &v, sizeof(v)); break; }
+		case Type::SHORT: { auto v = static_cast<short>(value); std::memcpy(data, &v, sizeof(v)); break; }
+		case Type::USHORT: { auto v = static_cast<unsigned short>(value); std::memcpy(data, &v, sizeof(v)); break; }
+		case Type::INT: { auto v = static_cast<int>(value); std::memcpy(data, &v, sizeof(v)); break; }
+		case Type::UINT: { auto v = static_cast<unsigned int>(value); std::memcpy(data, &v, sizeof(v)); break; }
+		case Type::FLOAT: { auto v = static_cast<float>(value); std::memcpy(data, &v, sizeof(v)); break; }
+		case Type::DOUBLE: { auto v = static_cast<double>(value); std::memcpy(data, &v, sizeof(v)); break; }
+		}
+	}
+
 	struct ElementDefinition;
+	class ElementBuffer;
+
+	// IScalarProperty interface over one value of an ElementBuffer.
+	class ElementBufferProperty : public IScalarProperty
+	{
+	public:
+		ElementBufferProperty(ElementBuffer* buffer, std::size_t index)
+			: m_buffer(buffer), m_index(index) {};
+
+		inline virtual ElementBufferProperty& operator=(unsigned int value) override;
+		inline virtual ElementBufferProperty& operator=(int value) override;
+		inline virtual ElementBufferProperty& operator=(float value) override;
+		inline virtual ElementBufferProperty& operator=(double value) override;
 
+		inline virtual operator unsigned int() override;
+		inline virtual operator int() override;
+		inline virtual operator float() override;
+		inline virtual operator double() override;
+
+	private:
+		friend class ElementBuffer;
+		ElementBuffer* m_buffer;
+		std::size_t m_index;
+	};
+
+	// Values of one element, stored contiguously with their native type.
 	class ElementBuffer
 	{
 	public:
-		ElementBuffer() = default;
+		ElementBuffer() : m_isList(false), m_listType(Type::UCHAR), m_listStart(0), m_listOffset(0) {};
 		ElementBuffer(const ElementDefinition& definition);
+		ElementBuffer(const ElementBuffer& other) = delete;
+		ElementBuffer(ElementBuffer&& other);
+		ElementBuffer& operator=(ElementBuffer&& other);
 
 	public:
 		void reset(size_t size);
-		size_t size() const { return properties.size(); };
-		IScalarProperty& operator[](size_t index);
+		size_t size() const { return m_types.size(); };
+		Type type(size_t index) const { return m_types[index]; };
+
+		template<typename T>
+		T get(size_t index) const { return readScalar<T>(data(index), m_types[index]); };
+		template<typename T>
+		void set(size_t index, T value) { writeScalar<T>(data(index), m_types[index], value); };
+
+		// Storage of a value, in its native type.
+		char* data(size_t index) { return reinterpret_cast<char*>(m_storage.data()) + m_offsets[index]; };
+		const char* data(size_t index) const { return reinterpret_cast<const char*>(m_storage.data()) + m_offsets[index]; };
+
+		// Compatibility access through the IScalarProperty interface.
+		IScalarProperty& operator[](size_t index) { return m_properties[index]; };
 
 	private:
 		void appendScalarProperty(Type type);
 		void appendListProperty(Type type);
-		std::unique_ptr<IScalarProperty> getScalarProperty(Type type);
+		void resizeStorage(std::size_t byteSize);
+		void rebindProperties();
 
 	private:
 		bool m_isList;
 		Type m_listType;
-		std::vector<std::unique_ptr<IScalarProperty>> properties;
+		std::size_t m_listStart;
+		std::size_t m_listOffset;
+		std::vector<Type> m_types;
+		std::vector<std::size_t> m_offsets;
+		// 64-bit words keep the values aligned for every PLY type.
+		std::vector<std::uint64_t> m_storage;
+		std::vector<ElementBufferProperty> m_properties;
 	};
 
+	ElementBufferProperty& ElementBufferProperty::operator=(unsigned int value) { m_buffer->set(m_index, value); return *this; }
+	ElementBufferProperty& ElementBufferProperty::operator=(int value) { m_buffer->set(m_index, value); return *this; }
+	ElementBufferProperty& ElementBufferProperty::operator=(float value) { m_buffer->set(m_index, value); return *this; }
+	ElementBufferProperty& ElementBufferProperty::operator=(double value) { m_buffer->set(m_index, value); return *this; }
+
+	ElementBufferProperty::operator unsigned int() { return m_buffer->get<unsigned int>(m_index); }
+	ElementBufferProperty::operator int() { return m_buffer->get<int>(m_index); }
+	ElementBufferProperty::operator float() { return m_buffer->get<float>(m_index); }
+	ElementBufferProperty::operator double() { return m_buffer->get<double>(m_index); }
+
+	class FileParser;
+
+	// Group of consecutive elements of the same type, stored as one typed array per property.
+	// For an element made of a list property, the list values of all the elements are
+	// stored one after the other in column 0, and listOffsets() gives where each list starts.
+	class ElementBatch
+	{
+	public:
+		ElementBatch() = default;
+		ElementBatch(const ElementDefinition& definition, std::size_t capacity);
+
+	public:
+		std::size_t size() const { return m_size; };
+		std::size_t firstIndex() const { return m_firstIndex; };
+		std::size_t propertyCount() const { return m_columns.size(); };
+		Type type(std::size_t property) const { return m_columns[property].type; };
+		bool isList() const { return m_isList; };
+
+		template<typename T>
+		Span<const T> column(std::size_t property) const;
+		Span<const std::size_t> listOffsets() const;
+
+		// Untyped access to a column, holding values of type(property).
+		const char* columnData(std::size_t property) const { return m_columns[property].data(); };
+		std::size_t typeSize(std::size_t property) const { return m_columns[property].typeSize; };
+
+	private:
+		friend class FileParser;
+		friend class TextDecoder;
+
+		struct Column
+		{
+			Type type;
+			std::size_t typeSize;
+			// 64-bit words keep the values aligned for every PLY type.
+			std::vector<std::uint64_t> storage;
+
+			char* data() { return reinterpret_cast<char*>(storage.data()); };
+			const char* data() const { return reinterpret_cast<const char*>(storage.data()); };
+		};
+
+		void clear(std::size_t firstIndex);
+		char* value(std::size_t property, std::size_t index) { return m_columns[property].data() + index * m_columns[property].typeSize; };
+		char* appendList(std::size_t length);
+
+	private:
+		bool m_isList;
+		std::size_t m_size;
+		std::size_t m_firstIndex;
+		std::vector<Column> m_columns;
+		std::vector<std::size_t> m_listOffsets;
+	};
+
+	template<typename T>
+	Span<const T> ElementBatch::column(std::size_t property) const
+	{
+		const auto& column = m_columns.at(property);
+		if (column.type != TypeOf<T>::value)
+		{
+			throw std::runtime_error("Batch column type mismatch.");
+		}
+		const std::size_t count = m_isList ? m_listOffsets[m_size] : m_size;
+		return Span<const T>(reinterpret_cast<const T*>(column.data()), count);
+	}
+
+	// The lists of all the elements of one type (e.g. the vertex indices of the faces), filled by File::setListReadTarget().
+	// Their values are stored one after the other, element i holding the values [offset(i), offset(i + 1)).
+	// While every list has the same length, e.g. for a triangle or quad mesh, width() is that length, the values
+	// form a dense size() x width() array and offsets() is empty. Otherwise width() is 0 and offsets() has size() + 1 entries.
+	class ListColumn
+	{
+	public:
+		ListColumn();
+
+	public:
+		std::size_t size() const { return m_size; };
+		Type type() const { return m_type; };
+		std::size_t width() const { return m_width; };
+		std::size_t valueCount() const { return m_width != 0 ? m_size * m_width : m_offsets.back(); };
+		std::size_t offset(std::size_t index) const { return m_width != 0 ? index * m_width : m_offsets[index]; };
+		Span<const std::size_t> offsets() const;
+
+		template<typename T>
+		Span<const T> values() const;
+		// Untyped access to the values, of type().
+		const char* data() const { return reinterpret_cast<const char*>(m_storage.data()); };
+
+	private:
+		friend class FileParser;
+
+		void reset(Type type);
+		void reserve(std::size_t valueCount);
+		// Room for the values of count more lists of the given length.
+		char* appendLists(std::size_t count, std::size_t length);
+
+	private:
+		Type m_type;
+		std::size_t m_typeSize;
+		std::size_t m_size;
+		std::size_t m_width;
+		// 64-bit words keep the values aligned for every PLY type, grown geometrically.
+		std::vector<std::uint64_t> m_storage;
+		std::vector<std::size_t> m_offsets;
+	};
+
+	template<typename T>
+	Span<const T> ListColumn::values() const
+	{
+		if (m_type != TypeOf<T>::value)
+		{
+			throw std::runtime_error("List column type mismatch.");
+		}
+		return Span<const T>(reinterpret_cast<const T*>(m_storage.data()), valueCount());
+	}
+
 	struct Property
 	{
 		Property(const std::string& name, Type type, bool isList)
@@ -139,21 +415,128 @@ namespace libply
 	};
 
 	typedef std::function< void(ElementBuffer&) > ElementReadCallback;
+	typedef std::function< void(ElementBatch&) > ElementBatchReadCallback;
+	const std::size_t DEFAULT_BATCH_SIZE = 4096;
+	const std::size_t DEFAULT_INDEX_INTERVAL = 1024;
+	const std::size_t DEFAULT_READ_AHEAD_CHUNK_SIZE = 1 << 20;
+	const unsigned int DEFAULT_READ_AHEAD_QUEUE_DEPTH = 4;
+
+	// Receives all the elements of one type, either as raw binary rows or as decoded batches.
+	class IElementReader
+	{
+	public:
+		virtual ~IElementReader() = default;
+
+		// Called before the elements are read. rowsAvailable is true when the elements are fixed size
+		// binary rows in host byte order; returning true then selects readRows() over readBatch().
+		virtual bool begin(const Element& definition, bool rowsAvailable) = 0;
+		// Consecutive packed rows, laid out as in the file.
+		virtual void readRows(const char* rows, std::size_t count) = 0;
+		// Never called concurrently, but with DeliveryOrder::UNORDERED the batches may come in any order.
+		virtual void readBatch(ElementBatch& batch) = 0;
+	};
 
-	class FileParser;
+	template<typename T, typename Fields>
+	class StructBinding;
+
+	// Pull access to the elements of one type, created by File::cursor().
+	// Each cursor keeps its own position, cursors over different element types can be interleaved
+	// when the input can seek (files, not pipes).
+	// A cursor is valid as long as the File it comes from.
+	class ElementCursor
+	{
+	public:
+		// Decode the next elements into batch, up to the batch size of the cursor.
+		// Returns false once every element has been read.
+		// The batch is set up for the element type on its first use with the cursor, then reused.
+		bool next(ElementBatch& batch);
+		// Index of the next element to read.
+		std::size_t position() const { return m_next; };
+
+	private:
+		friend class FileParser;
+
+		ElementCursor(FileParser& parser, std::size_t element, std::size_t batchSize);
+
+	private:
+		FileParser* m_parser;
+		std::size_t m_element;
+		std::size_t m_batchSize;
+		std::size_t m_next;
+		std::streamsize m_offset;
+		const ElementBatch* m_batch;
+	};
 
 	typedef std::vector<Element> ElementsDefinition;
 
+	// Elements of one type handled by the reads or writes, with their values (list values for lists).
+	struct ElementStatistics
+	{
+		std::string name;
+		std::uint64_t elements;
+		std::uint64_t values;
+	};
+
+	// Work of the reads of a File or the writes of a FileOut, accumulated since its construction.
+	// Collected only when the library is built with LIBPLYXX_STATISTICS defined (the CMake option of the same name),
+	// otherwise enabled is false and everything is zero.
+	// Times are summed over the threads taking part: io is spent fetching or writing file chunks,
+	// callback in the callbacks and readers, parse in everything else (formatting when writing).
+	// Memory mapped input has no I/O phase, its bytes are counted as the reads go through them.
+	struct Statistics
+	{
+		bool enabled;
+		std::uint64_t bytesRead;
+		std::uint64_t bytesWritten;
+		// Chunks read from or written to the file, memory mapped input has none.
+		std::uint64_t chunksFetched;
+		// Growths of the value storage of element buffers and batches.
+		std::uint64_t bufferAllocations;
+		std::vector<ElementStatistics> elements;
+		PhaseTime io;
+		PhaseTime parse;
+		PhaseTime callback;
+	};
+
 	class File
 	{
 	public:
+		// gzip and zstd compressed files are decompressed on the fly when the library is built with zlib
+		// and zstd, every read works on them but seeking backwards (ranges, cursors) decodes again from the start.
 		File(const PATH_STRING& filename);
+		// Parse a PLY held in memory, in place without copying. The data must outlive the File.
+		File(const void* data, std::size_t size);
+		// Read a PLY from a stream (e.g. a pipe), from its current position. The stream must outlive the File.
+		// Reads continue from the header without seeking, only seekable streams allow reading twice or seeking backwards.
+		explicit File(std::istream& stream);
 		~File();
 
 		ElementsDefinition definitions() const;
 		void setElementReadCallback(std::string elementName, ElementReadCallback& readCallback);
+		// Deliver the elements by groups of up to batchSize elements instead of one at a time.
+		void setElementBatchReadCallback(std::string elementName, ElementBatchReadCallback& readCallback, std::size_t batchSize = DEFAULT_BATCH_SIZE);
+		void setElementReader(std::string elementName, std::shared_ptr<IElementReader> reader);
+		// Fill target with one T per element, using the member to property mapping of binding.
+		template<typename T, typename Fields>
+		void setElementReadTarget(std::string elementName, const StructBinding<T, Fields>& binding, std::vector<T>& target);
+		// Fill target with the lists of an element made of a single list property, in file order whatever the delivery order.
+		// Throws std::invalid_argument for an element with other properties.
+		// Binary runs of lists of the same length are copied as fixed size rows.
+		void setListReadTarget(std::string elementName, ListColumn& target);
+		// Decode only the given properties of an element, the other ones are skipped.
+		// Buffers and batches then hold the selected properties only, in file order.
+		void select(const std::string& elementName, const std::vector<std::string>& propertyNames);
 		void read();
 
+		// Record the offset of every interval-th element of each element type, for readRange().
+		// With sidecar, the index is loaded from (or saved to) the file path followed by ".plyidx",
+		// and rebuilt when the size or modification time of the file no longer match.
+		void buildIndex(std::size_t interval = DEFAULT_INDEX_INTERVAL, bool sidecar = false);
+		// Read elements [first, first + count) of a type, seeking through the index (built if missing).
+		void readRange(const std::string& elementName, std::size_t first, std::size_t count, ElementReadCallback& callback);
+		// Pull style alternative to read(), see ElementCursor.
+		ElementCursor cursor(const std::string& elementName, std::size_t batchSize = DEFAULT_BATCH_SIZE);
+
 	public:
 		enum class Format
 		{
@@ -162,26 +545,377 @@ namespace libply
 			BINARY_BIG_ENDIAN
 		};
 
+		// Order in which elements decoded by worker threads reach the callbacks.
+		// UNORDERED callbacks are called concurrently from the worker threads, in any order,
+		// and must be thread-safe. ElementBatch::firstIndex() tells where a batch belongs.
+		enum class DeliveryOrder
+		{
+			FILE_ORDER,
+			UNORDERED
+		};
+
+		// Number of threads decoding the data (1 by default, i.e. no worker thread).
+		// ASCII data is decoded in parallel when held in memory, i.e. memory buffers and files that could be memory mapped.
+		void setThreadCount(unsigned int threadCount);
+		void setDeliveryOrder(DeliveryOrder order);
+
+		// Read the data with asynchronous reads of chunkSize bytes, up to queueDepth of them ahead of the
+		// decoding, instead of through a memory mapping. Suits network file systems and cold caches.
+		// With direct, the page cache is bypassed where the file system allows it.
+		// Decoding is then sequential, whatever the thread count. No effect on compressed files, buffers or streams.
+		void setReadAhead(std::size_t chunkSize = DEFAULT_READ_AHEAD_CHUNK_SIZE,
+			unsigned int queueDepth = DEFAULT_READ_AHEAD_QUEUE_DEPTH, bool direct = false);
+
+		Statistics statistics() const;
+		void resetStatistics();
+
 	private:
 		PATH_STRING m_filename;
 		std::unique_ptr<FileParser> m_parser;
 	};
 
+	// Header of a PLY file.
+	struct FileHeader
+	{
+		File::Format format;
+		ElementsDefinition definitions;
+		// Offset of the data, right after end_header.
+		std::uint64_t dataOffset;
+	};
+
+	// Read only the header of a file, by small reads up to end_header. Throws like File on invalid input.
+	FileHeader probeHeader(const PATH_STRING& filename);
+
+	// Header of one of the files of probeHeaders(), or the reason it could not be read (error is empty on success).
+	struct HeaderProbe
+	{
+		PATH_STRING filename;
+		std::string error;
+		FileHeader header;
+	};
+
+	// Probe the headers of many files concurrently on threadCount threads (the hardware concurrency if 0).
+	// Results are in the order of filenames.
+	std::vector<HeaderProbe> probeHeaders(const std::vector<PATH_STRING>& filenames, unsigned int threadCount = 0);
+
+
+	template<typename T, typename M>
+	struct FieldBinding
+	{
+		typedef M MemberType;
+
+		M T::* member;
+		const char* name;
+	};
+
+	template<typename T>
+	std::tuple<> makeFieldBindings()
+	{
+		return std::tuple<>();
+	}
+
+	template<typename T, typename M, typename... Rest>
+	auto makeFieldBindings(M T::* member, const char* name, Rest... rest)
+	{
+		return std::tuple_cat(std::make_tuple(FieldBinding<T, M>{ member, name }), makeFieldBindings<T>(rest...));
+	}
+
+	// Mapping of struct members to PLY property names, see bind().
+	template<typename T, typename Fields>
+	class StructBinding
+	{
+	public:
+		static const std::size_t FIELD_COUNT = std::tuple_size<Fields>::value;
+
+	public:
+		explicit StructBinding(const Fields& fields) : m_fields(fields) {};
+
+		const Fields& fields() const { return m_fields; };
+		// Index in definition of the property bound to each field.
+		std::array<std::size_t, FIELD_COUNT> resolve(const Element& definition) const
+		{
+			std::array<std::size_t, FIELD_COUNT> indices;
+			resolveFields(definition, indices, std::make_index_sequence<FIELD_COUNT>());
+			return indices;
+		};
+		// Byte offset of each field in T.
+		std::array<std::size_t, FIELD_COUNT> offsets() const
+		{
+			std::array<std::size_t, FIELD_COUNT> offsets;
+			offsetFields(offsets, std::make_index_sequence<FIELD_COUNT>());
+			return offsets;
+		};
+		// Whether the field has the same representation as the PLY type.
+		std::array<bool, FIELD_COUNT> matchTypes(const std::array<Type, FIELD_COUNT>& types) const
+		{
+			std::array<bool, FIELD_COUNT> matches;
+			matchFields(types, matches, std::make_index_sequence<FIELD_COUNT>());
+			return matches;
+		};
+		// Convert count values of each field, found every stride bytes from sources[field].
+		void decode(T* target, std::size_t count, const std::array<const char*, FIELD_COUNT>& sources,
+			const std::array<std::size_t, FIELD_COUNT>& strides, const std::array<Type, FIELD_COUNT>& types) const
+		{
+			decodeFields(target, count, sources, strides, types, std::make_index_sequence<FIELD_COUNT>());
+		};
+
+	private:
+		template<std::size_t... I>
+		void resolveFields(const Element& definition, std::array<std::size_t, FIELD_COUNT>& indices, std::index_sequence<I...>) const
+		{
+			using expand = int[];
+			(void)expand{ 0, (indices[I] = findProperty(definition, std::get<I>(m_fields).name), 0)... };
+		}
+
+		template<std::size_t... I>
+		void offsetFields(std::array<std::size_t, FIELD_COUNT>& offsets, std::index_sequence<I...>) const
+		{
+			const T probe{};
+			const char* base = reinterpret_cast<const char*>(&probe);
+			using expand = int[];
+			(void)expand{ 0, (offsets[I] = reinterpret_cast<const char*>(&(probe.*(std::get<I>(m_fields).member))) - base, 0)... };
+		}
+
+		template<std::size_t... I>
+		void matchFields(const std::array<Type, FIELD_COUNT>& types, std::array<bool, FIELD_COUNT>& matches, std::index_sequence<I...>) const
+		{
+			using expand = int[];
+			(void)expand{ 0, (matches[I] = isSameRepresentation<typename std::tuple_element<I, Fields>::type::MemberType>(types[I]), 0)... };
+		}
+
+		template<std::size_t... I>
+		void decodeFields(T* target, std::size_t count, const std::array<const char*, FIELD_COUNT>& sources,
+			const std::array<std::size_t, FIELD_COUNT>& strides, const std::array<Type, FIELD_COUNT>& types, std::index_sequence<I...>) const
+		{
+			using expand = int[];
+			(void)expand{ 0, (decodeField(target, count, std::get<I>(m_fields).member, sources[I], strides[I], types[I]), 0)... };
+		}
+
+		template<typename M>
+		static void decodeField(T* target, std::size_t count, M T::* member, const char* source, std::size_t stride, Type type)
+		{
+			// Select the source type once, so the loop runs without conversion dispatch.
+			switch (type)
+			{
+			case Type::CHAR: decodeField<M, signed char>(target, count, member, source, stride); break;
+			case Type::UCHAR: decodeField<M, unsigned char>(target, count, member, source, stride); break;
+			case Type::SHORT: decodeField<M, short>(target, count, member, source, stride); break;
+			case Type::USHORT: decodeField<M, unsigned short>(target, count, member, source, stride); break;
+			case Type::INT: decodeField<M, int>(target, count, member, source, stride); break;
+			case Type::UINT: decodeField<M, unsigned int>(target, count, member, source, stride); break;
+			case Type::FLOAT: decodeField<M, float>(target, count, member, source, stride); break;
+			case Type::DOUBLE: decodeField<M, double>(target, count, member, source, stride); break;
+			}
+		}
+
+		template<typename M, typename S>
+		static void decodeField(T* target, std::size_t count, M T::* member, const char* source, std::size_t stride)
+		{
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				S value;
+				std::memcpy(&value, source + i * stride, sizeof(S));
+				target[i].*member = static_cast<M>(value);
+			}
+		}
+
+		static std::size_t findProperty(const Element& definition, const char* name)
+		{
+			for (std::size_t i = 0; i < definition.properties.size(); ++i)
+			{
+				if (definition.properties[i].name == name)
+				{
+					if (definition.properties[i].isList)
+					{
+						throw std::runtime_error(std::string("Cannot bind list property ") + name + ".");
+					}
+					return i;
+				}
+			}
+			throw std::runtime_error(std::string("Property ") + name + " not found in element " + definition.name + ".");
+		}
+
+	private:
+		Fields m_fields;
+	};
+
+	// Bind members of T to PLY properties, given as pairs of member pointer and property name:
+	//   libply::bind<Vertex>(&Vertex::x, "x", &Vertex::y, "y", &Vertex::z, "z")
+	template<typename T, typename... Args>
+	auto bind(Args... args)
+	{
+		using Fields = decltype(makeFieldBindings<T>(args...));
+		return StructBinding<T, Fields>(makeFieldBindings<T>(args...));
+	}
+
+	// Element reader filling a vector of structs.
+	// Rows are copied as a whole when the struct layout matches the file layout,
+	// otherwise each field is converted from its property.
+	template<typename T, typename Fields>
+	class StructReader : public IElementReader
+	{
+	public:
+		static const std::size_t FIELD_COUNT = StructBinding<T, Fields>::FIELD_COUNT;
+
+	public:
+		StructReader(const StructBinding<T, Fields>& binding, std::vector<T>& target)
+			: m_binding(binding), m_target(target), m_count(0), m_stride(0), m_copyRows(false) {};
+
+		virtual bool begin(const Element& definition, bool rowsAvailable) override
+		{
+			m_indices = m_binding.resolve(definition);
+			const auto& indices = m_indices;
+			std::vector<std::size_t> propertyOffsets;
+			m_stride = 0;
+			for (const auto& p : definition.properties)
+			{
+				propertyOffsets.push_back(m_stride);
+				m_stride += typeSize(p.type);
+			}
+			for (std::size_t f = 0; f < FIELD_COUNT; ++f)
+			{
+				m_types[f] = definition.properties[indices[f]].type;
+				m_rowOffsets[f] = propertyOffsets[indices[f]];
+			}
+
+			// Every property must land on a member of the same type at the same offset.
+			const auto fieldOffsets = m_binding.offsets();
+			const auto typeMatches = m_binding.matchTypes(m_types);
+			std::vector<bool> covered(definition.properties.size(), false);
+			bool sameLayout = std::is_trivially_copyable<T>::value && m_stride <= sizeof(T);
+			for (std::size_t f = 0; f < FIELD_COUNT; ++f)
+			{
+				sameLayout = sameLayout && typeMatches[f] && fieldOffsets[f] == m_rowOffsets[f];
+				covered[indices[f]] = true;
+			}
+			for (bool c : covered)
+			{
+				sameLayout = sameLayout && c;
+			}
+			m_copyRows = sameLayout;
+
+			m_target.clear();
+			m_target.resize(definition.size);
+			m_count = 0;
+			return rowsAvailable;
+		};
+
+		virtual void readRows(const char* rows, std::size_t count) override
+		{
+			T* target = m_target.data() + m_count;
+			if (m_copyRows && m_stride == sizeof(T))
+			{
+				std::memcpy(static_cast<void*>(target), rows, count * m_stride);
+			}
+			else if (m_copyRows)
+			{
+				for (std::size_t i = 0; i < count; ++i)
+				{
+					std::memcpy(static_cast<void*>(target + i), rows + i * m_stride, m_stride);
+				}
+			}
+			else
+			{
+				std::array<const char*, FIELD_COUNT> sources;
+				std::array<std::size_t, FIELD_COUNT> strides;
+				for (std::size_t f = 0; f < FIELD_COUNT; ++f)
+				{
+					sources[f] = rows + m_rowOffsets[f];
+					strides[f] = m_stride;
+				}
+				m_binding.decode(target, count, sources, strides, m_types);
+			}
+			m_count += count;
+		};
+
+		virtual void readBatch(ElementBatch& batch) override
+		{
+			std::array<const char*, FIELD_COUNT> sources;
+			std::array<std::size_t, FIELD_COUNT> strides;
+			for (std::size_t f = 0; f < FIELD_COUNT; ++f)
+			{
+				const std::size_t property = m_indices[f];
+				sources[f] = batch.columnData(property);
+				strides[f] = batch.typeSize(property);
+			}
+			m_binding.decode(m_target.data() + batch.firstIndex(), batch.size(), sources, strides, m_types);
+			m_count += batch.size();
+		};
+
+	private:
+		StructBinding<T, Fields> m_binding;
+		std::vector<T>& m_target;
+		std::size_t m_count;
+		std::size_t m_stride;
+		bool m_copyRows;
+		std::array<std::size_t, FIELD_COUNT> m_indices;
+		std::array<Type, FIELD_COUNT> m_types;
+		std::array<std::size_t, FIELD_COUNT> m_rowOffsets;
+	};
+
+	template<typename T, typename Fields>
+	void File::setElementReadTarget(std::string elementName, const StructBinding<T, Fields>& binding, std::vector<T>& target)
+	{
+		setElementReader(elementName, std::make_shared<StructReader<T, Fields>>(binding, target));
+	}
 
 	typedef std::function< void(ElementBuffer&, size_t index) > ElementWriteCallback;
 
+	// Memory holding the values of one property of all the elements written by FileOut.
+	// Element i has its value at data + i * stride, or for lists, the values
+	// [offsets[i], offsets[i + 1]) of the contiguous array at data.
+	struct PropertyArray
+	{
+		Type type;
+		const char* data;
+		std::size_t stride;
+		const char* offsets;
+		std::size_t offsetSize;
+	};
+
+	// Array of values, contiguous (SoA) or a member of an array of structs (AoS) with the struct size as stride.
+	template<typename T>
+	PropertyArray propertyArray(const T* data, std::size_t stride = sizeof(T))
+	{
+		return PropertyArray{ TypeOf<T>::value, reinterpret_cast<const char*>(data), stride, nullptr, 0 };
+	}
+
+	// List values in compressed sparse row form, offsets has one more entry than there are elements.
+	template<typename T, typename I>
+	PropertyArray listArray(const I* offsets, const T* values)
+	{
+		static_assert(std::is_integral<I>::value, "List offsets must have an integral type.");
+		return PropertyArray{ TypeOf<T>::value, reinterpret_cast<const char*>(values), sizeof(T), reinterpret_cast<const char*>(offsets), sizeof(I) };
+	}
+
+	// One array for each property of an element, in the order of the element definition.
+	typedef std::vector<PropertyArray> ElementArrays;
+
 	class FileOut
 	{
 	public:
 		FileOut(const PATH_STRING& filename, File::Format format);
-		
+		~FileOut();
+
 		void setElementsDefinition(const ElementsDefinition& definitions);
 		void setElementWriteCallback(const std::string& elementName, ElementWriteCallback& writeCallback);
+		// Write the element from arrays instead of a callback, the arrays must stay valid until write().
+		void setElementArrays(const std::string& elementName, const ElementArrays& arrays);
+		// Write FLOAT and DOUBLE values of ASCII files rounded to this number of decimals.
+		// Negative (the default) writes the shortest text that reads back to the same value.
+		void setRealPrecision(int decimals);
+		// Size of the output buffer, written to the file each time it is full.
+		void setBufferSize(std::size_t bytes);
+		// Reserve the disk space of binary files without lists before writing.
+		void setPreallocate(bool preallocate);
 		void write();
 
+		Statistics statistics() const { return m_statistics; };
+		void resetStatistics();
+
 	private:
 		void createFile();
-		void writeHeader();
+		std::string writeHeader();
 		void writeData();
 
 	private:
@@ -189,5 +923,11 @@ namespace libply
 		File::Format m_format;
 		ElementsDefinition m_definitions;
 		std::map<std::string, ElementWriteCallback> m_writeCallbacks;
+		std::map<std::string, ElementArrays> m_elementArrays;
+		int m_realPrecision;
+		std::size_t m_bufferSize;
+		bool m_preallocate;
+		std::unique_ptr<fileio::OutputFile> m_file;
+		Statistics m_statistics;
 	};
 }
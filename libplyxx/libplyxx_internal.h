@@ -1,172 +1,146 @@
 #pragma once
 
 #include "libplyxx.h"
-#include <sstream>
+#include "decompress.h"
+#include "fileio.h"
+#include "threadpool.h"
+#include "byteswap.h"
+#include "floatformat.h"
+#include "textdecoder.h"
+
+#include <mutex>
 
 namespace libply
 {
 	typedef std::unordered_map<std::string, Type> TypeMap;
 	const TypeMap TYPE_MAP =
 	{
+		{ "char", Type::CHAR },
 		{ "uchar", Type::UCHAR },
+		{ "short", Type::SHORT },
+		{ "ushort", Type::USHORT },
 		{ "int", Type::INT },
+		{ "uint", Type::UINT },
 		{ "float", Type::FLOAT },
 		{ "double", Type::DOUBLE },
+		{ "int8", Type::CHAR },
+		{ "uint8", Type::UCHAR },
+		{ "int16", Type::SHORT },
+		{ "uint16", Type::USHORT },
+		{ "int32", Type::INT },
+		{ "uint32", Type::UINT },
+		{ "float32", Type::FLOAT },
+		{ "float64", Type::DOUBLE },
 	};
 
 	typedef std::unordered_map<Type, unsigned int> TypeSizeMap;
 	const TypeSizeMap TYPE_SIZE_MAP =
 	{
+		{ Type::CHAR, 1 },
 		{ Type::UCHAR, 1 },
+		{ Type::SHORT, 2 },
+		{ Type::USHORT, 2 },
 		{ Type::INT, 4 },
+		{ Type::UINT, 4 },
 		{ Type::FLOAT, 4 },
 		{ Type::DOUBLE, 8 },
 	};
 
-	/// Type conversion functions.
-
-	inline void convert_UCHAR(const textio::SubString& token, IScalarProperty& property)
+	// Read a binary list length stored with the given type.
+	inline std::size_t readListLength(const char* buffer, Type type, bool swapBytes)
 	{
-		property = textio::stou<unsigned char>(token);
+		if (swapBytes)
+		{
+			char swapped[sizeof(std::uint64_t)];
+			std::memcpy(swapped, buffer, TYPE_SIZE_MAP.at(type));
+			swapByteOrder(swapped, 1, TYPE_SIZE_MAP.at(type));
+			return readScalar<std::size_t>(swapped, type);
+		}
+		return readScalar<std::size_t>(buffer, type);
 	}
 
-	inline void convert_INT(const textio::SubString& token, IScalarProperty& property)
-	{
-		property = textio::stoi<int>(token);
-	}
+	/// Type formatting functions, writing the text of a value stored with its native type.
+	/// Real values are written with the given number of decimals, or in shortest round-trip form when negative.
 
-	inline void convert_FLOAT(const textio::SubString& token, IScalarProperty& property)
+	inline char* write_convert_CHAR(const char* data, char* out, int)
 	{
-		property = textio::stor<float>(token);
+		signed char value;
+		std::memcpy(&value, data, sizeof(value));
+		return textio::formatInteger(out, value);
 	}
 
-	inline void convert_DOUBLE(const textio::SubString& token, IScalarProperty& property)
+	inline char* write_convert_UCHAR(const char* data, char* out, int)
 	{
-		property = textio::stor<double>(token);
+		unsigned char value;
+		std::memcpy(&value, data, sizeof(value));
+		return textio::formatInteger(out, value);
 	}
 
-	typedef void(*ConversionFunction)(const textio::SubString&, IScalarProperty&);
-	typedef std::unordered_map<Type, ConversionFunction> ConversionFunctionMap;
-
-	const ConversionFunctionMap CONVERSION_MAP =
+	inline char* write_convert_SHORT(const char* data, char* out, int)
 	{
-		{ Type::UCHAR , convert_UCHAR },
-		{ Type::INT, convert_INT },
-		{ Type::FLOAT, convert_FLOAT },
-		{ Type::DOUBLE, convert_DOUBLE }
-	};
-
-	/// Type casting functions.
-
-	inline void cast_UCHAR(char* buffer, IScalarProperty& property)
-	{
-		property = *reinterpret_cast<unsigned char*>(buffer);
+		short value;
+		std::memcpy(&value, data, sizeof(value));
+		return textio::formatInteger(out, value);
 	}
 
-	inline void cast_INT(char* buffer, IScalarProperty& property)
+	inline char* write_convert_USHORT(const char* data, char* out, int)
 	{
-		property = *reinterpret_cast<int*>(buffer);
+		unsigned short value;
+		std::memcpy(&value, data, sizeof(value));
+		return textio::formatInteger(out, value);
 	}
 
-	inline void cast_FLOAT(char* buffer, IScalarProperty& property)
+	inline char* write_convert_INT(const char* data, char* out, int)
 	{
-		property = *reinterpret_cast<float*>(buffer);
+		int value;
+		std::memcpy(&value, data, sizeof(value));
+		return textio::formatInteger(out, value);
 	}
 
-	inline void cast_DOUBLE(char* buffer, IScalarProperty& property)
+	inline char* write_convert_UINT(const char* data, char* out, int)
 	{
-		property = *reinterpret_cast<double*>(buffer);
+		unsigned int value;
+		std::memcpy(&value, data, sizeof(value));
+		return textio::formatInteger(out, value);
 	}
 
-	typedef void(*CastFunction)(char* buffer, IScalarProperty&);
-	typedef std::unordered_map<Type, CastFunction> CastFunctionMap;
-
-	const CastFunctionMap CAST_MAP =
+	inline char* write_convert_FLOAT(const char* data, char* out, int decimals)
 	{
-		{ Type::UCHAR , cast_UCHAR },
-		{ Type::INT, cast_INT },
-		{ Type::FLOAT, cast_FLOAT },
-		{ Type::DOUBLE, cast_DOUBLE }
-	};
-
-	inline std::stringstream& write_convert_UCHAR(IScalarProperty& property, std::stringstream& ss)
-	{
-		ss << static_cast<unsigned int>(property);
-		return ss;
+		float value;
+		std::memcpy(&value, data, sizeof(value));
+		return decimals < 0 ? textio::formatReal(out, value) : textio::formatReal(out, value, decimals);
 	}
 
-	inline std::stringstream& write_convert_INT(IScalarProperty& property, std::stringstream& ss)
+	inline char* write_convert_DOUBLE(const char* data, char* out, int decimals)
 	{
-		ss << static_cast<int>(property);
-		return ss;
+		double value;
+		std::memcpy(&value, data, sizeof(value));
+		return decimals < 0 ? textio::formatReal(out, value) : textio::formatReal(out, value, decimals);
 	}
 
-	inline std::stringstream& write_convert_FLOAT(IScalarProperty& property, std::stringstream& ss)
-	{
-		ss << static_cast<float>(property);
-		return ss;
-	}
-
-	inline std::stringstream& write_convert_DOUBLE(IScalarProperty& property, std::stringstream& ss)
-	{
-		ss << static_cast<double>(property);
-		return ss;
-	}
-
-	typedef std::stringstream&(*WriteConvertFunction)(IScalarProperty&, std::stringstream&);
+	typedef char*(*WriteConvertFunction)(const char*, char*, int);
 	typedef std::unordered_map<Type, WriteConvertFunction> WriteConvertFunctionMap;
 
 	const WriteConvertFunctionMap WRITE_CONVERT_MAP =
 	{
+		{ Type::CHAR, write_convert_CHAR },
 		{ Type::UCHAR , write_convert_UCHAR },
+		{ Type::SHORT, write_convert_SHORT },
+		{ Type::USHORT, write_convert_USHORT },
 		{ Type::INT, write_convert_INT },
+		{ Type::UINT, write_convert_UINT },
 		{ Type::FLOAT, write_convert_FLOAT },
 		{ Type::DOUBLE, write_convert_DOUBLE }
 	};
 
-	inline void write_cast_UCHAR(IScalarProperty& property, char* buffer, size_t& size)
-	{
-		*reinterpret_cast<unsigned char*>(buffer) = static_cast<unsigned int>(property);
-		size = sizeof(unsigned char);
-	}
-
-	inline void write_cast_INT(IScalarProperty& property, char* buffer, size_t& size)
-	{
-		*reinterpret_cast<int*>(buffer) = static_cast<int>(property);
-		size = sizeof(int);
-	}
-
-	inline void write_cast_FLOAT(IScalarProperty& property, char* buffer, size_t& size)
-	{
-		*reinterpret_cast<float*>(buffer) = static_cast<float>(property);
-		size = sizeof(float);
-	}
-
-	inline void write_cast_DOUBLE(IScalarProperty& property, char* buffer, size_t& size)
-	{
-		*reinterpret_cast<double*>(buffer) = static_cast<double>(property);
-		size = sizeof(double);
-	}
-
-	typedef void(*WriteCastFunction)(IScalarProperty& property, char* buffer, size_t& size);
-	typedef std::unordered_map<Type, WriteCastFunction> WriteCastFunctionMap;
-
-	const WriteCastFunctionMap WRITE_CAST_MAP =
-	{
-		{ Type::UCHAR , write_cast_UCHAR },
-		{ Type::INT, write_cast_INT },
-		{ Type::FLOAT, write_cast_FLOAT },
-		{ Type::DOUBLE, write_cast_DOUBLE }
-	};
-
 	struct PropertyDefinition
 	{
 		PropertyDefinition(const std::string& name, Type type, bool isList, Type listLengthType = Type::UCHAR)
 			: name(name), type(type), isList(isList), listLengthType(listLengthType),
-			conversionFunction(CONVERSION_MAP.at(type)),
-			castFunction(CAST_MAP.at(type)),
+			typeSize(TYPE_SIZE_MAP.at(type)),
+			listLengthTypeSize(TYPE_SIZE_MAP.at(listLengthType)),
 			writeConvertFunction(WRITE_CONVERT_MAP.at(type)),
-			writeCastFunction(WRITE_CAST_MAP.at(type))
+			selected(true)
 		{};
 		PropertyDefinition(const Property& p)
 			: PropertyDefinition(p.name, p.type, p.isList)
@@ -178,10 +152,11 @@ namespace libply
 		Type type;
 		bool isList;
 		Type listLengthType;
-		ConversionFunction conversionFunction;
-		CastFunction castFunction;
+		unsigned int typeSize;
+		unsigned int listLengthTypeSize;
 		WriteConvertFunction writeConvertFunction;
-		WriteCastFunction writeCastFunction;
+		// Decoded into the element buffers, unselected properties are skipped when reading.
+		bool selected;
 	};
 
 	struct ElementDefinition
@@ -199,6 +174,11 @@ namespace libply
 		};
 
 		Element getElement() const;
+		// Element with only the selected properties, as laid out in the buffers.
+		Element getSelectedElement() const;
+		bool isProjected() const;
+		// Size of an element in a binary file, or 0 when it holds a list.
+		std::size_t binaryStride() const;
 
 		std::string name;
 		ElementSize size;
@@ -206,37 +186,153 @@ namespace libply
 		std::size_t startLine;
 	};
 
+#ifdef LIBPLYXX_STATISTICS
+	// Collects the counters of the calling thread for its lifetime, then adds them to statistics,
+	// the time not spent in I/O or callbacks being parse time. Nested scopes have no effect.
+	class StatisticsScope
+	{
+	public:
+		// bytes is the member of Statistics receiving the counted bytes, mutex guards statistics if not null.
+		StatisticsScope(Statistics& statistics, std::mutex* mutex, std::uint64_t Statistics::* bytes);
+		StatisticsScope(const StatisticsScope& other) = delete;
+		StatisticsScope& operator=(const StatisticsScope& other) = delete;
+		~StatisticsScope();
+
+	private:
+		Statistics& m_statistics;
+		std::mutex* m_mutex;
+		std::uint64_t Statistics::* m_bytes;
+		bool m_active;
+		StatisticsCounters m_counters;
+		PhaseTime m_start;
+	};
+#endif
+
+	// Statistics with the element names and nothing counted.
+	Statistics emptyStatistics(const std::vector<std::string>& elementNames);
+
 	class FileParser
 	{
 	public:
 		explicit FileParser(const PATH_STRING& filename);
+		FileParser(const void* data, std::size_t size);
+		explicit FileParser(std::istream& stream);
 		FileParser(const FileParser& other) = delete;
 		~FileParser();
 		
 		std::vector<Element> definitions() const;
 		//void setElementInserter(std::string elementName, IElementInserter* inserter);
 		void setElementReadCallback(std::string elementName, ElementReadCallback& readCallback);
+		void setElementBatchReadCallback(std::string elementName, ElementBatchReadCallback& readCallback, std::size_t batchSize);
+		void setElementReader(std::string elementName, std::shared_ptr<IElementReader> reader);
+		void setListReadTarget(std::string elementName, ListColumn& target);
+		void setThreadCount(unsigned int threadCount) { m_threadCount = threadCount; };
+		void setDeliveryOrder(File::DeliveryOrder order) { m_deliveryOrder = order; };
+		void setReadAhead(std::size_t chunkSize, unsigned int queueDepth, bool direct);
+		void select(const std::string& elementName, const std::vector<std::string>& propertyNames);
 		void read();
+		void buildIndex(std::size_t interval, bool sidecar);
+		void readRange(const std::string& elementName, std::size_t first, std::size_t count, ElementReadCallback& callback);
+		ElementCursor cursor(const std::string& elementName, std::size_t batchSize);
+		bool next(ElementCursor& cursor, ElementBatch& batch);
+		Statistics statistics() const;
+		void resetStatistics();
 
 	private:
-		void readHeader();
-		void parseLine(const textio::SubString& substr, const ElementDefinition& elementDefinition, ElementBuffer& buffer);
-		void readBinaryElement(std::ifstream& fs, const ElementDefinition& elementDefinition, ElementBuffer& buffer);
+		// Parse the header of the input of the line reader.
+		void open();
+		ElementDefinition& elementDefinition(const std::string& elementName);
+		// Offset of the first element of a section.
+		std::streamsize sectionOffset(std::size_t element);
+
+	private:
+		// Offsets of every interval-th element of each section.
+		// Sections of fixed size binary elements only hold their start, other elements are found from it.
+		struct ElementIndex
+		{
+			std::size_t interval;
+			std::vector<std::vector<std::uint64_t>> sections;
+		};
+
+		// Receiver of the elements of one type, resolved from the registered callbacks.
+		struct ElementHandler
+		{
+			ElementReadCallback* elementCallback;
+			ElementBatchReadCallback* batchCallback;
+			IElementReader* reader;
+			ListColumn* listTarget;
+			std::size_t batchSize;
+			bool readRows;
+			// No receiver, the elements are skipped.
+			bool skip;
+		};
+		// Receives the batches decoded by a task, with the index of their element definition.
+		typedef std::function<void(std::size_t, ElementBatch&)> BatchSink;
+		typedef std::function<void(std::size_t, const BatchSink&)> DecodeTask;
+
+	private:
+		ElementHandler elementHandler(const ElementDefinition& elementDefinition);
+		void readElements(const ElementDefinition& elementDefinition, std::size_t count, ElementReadCallback& callback);
+		void skipElements(const ElementDefinition& elementDefinition, std::size_t count);
+		bool loadIndex(const PATH_STRING& filename, const fileio::FileStatus& status, std::size_t interval);
+		void saveIndex(const PATH_STRING& filename, const fileio::FileStatus& status) const;
+		void readElementBatches(const ElementDefinition& elementDefinition, ElementHandler& handler);
+		void readBatch(const ElementDefinition& elementDefinition, std::size_t count, ElementBatch& batch);
+		void readElementRows(const ElementDefinition& elementDefinition, IElementReader& reader);
+		void readListColumn(const ElementDefinition& elementDefinition, ListColumn& target);
+		void deliver(const ElementDefinition& elementDefinition, ElementHandler& handler, ElementBatch& batch) const;
+		void decodeParallel(ThreadPool& pool, std::size_t taskCount, const DecodeTask& decode, std::vector<ElementHandler>& handlers);
+		void readTextParallel(ThreadPool& pool, std::vector<ElementHandler>& handlers);
+		void readBinaryParallel(ThreadPool& pool, std::size_t element, std::vector<ElementHandler>& handlers);
+		void parseTextChunk(const char* begin, const char* end, std::size_t line, const std::vector<ElementHandler>& handlers, const BatchSink& sink) const;
+		void readBinaryElement(const ElementDefinition& elementDefinition, ElementBuffer& buffer);
+		void readBinaryElement(const ElementDefinition& elementDefinition, ElementBatch& batch);
+		static void decodeRows(const char* rows, std::size_t count, const ElementDefinition& elementDefinition, ElementBatch& batch, bool swapBytes);
+		static void copyElement(const ElementBatch& batch, std::size_t index, ElementBuffer& buffer);
 
 	private:
 		typedef std::map<std::string, ElementReadCallback> CallbackMap;
+		struct BatchReadCallback
+		{
+			ElementBatchReadCallback callback;
+			std::size_t batchSize;
+		};
+		typedef std::map<std::string, BatchReadCallback> BatchCallbackMap;
+		typedef std::map<std::string, std::shared_ptr<IElementReader>> ReaderMap;
+		typedef std::map<std::string, ListColumn*> ListTargetMap;
 
 	private:
 		PATH_STRING m_filename;
 		File::Format m_format;
+		// Binary data stored in the opposite byte order of the host.
+		bool m_swapBytes;
 		std::streamsize m_dataOffset;
-		textio::LineReader m_lineReader;
-		textio::Tokenizer m_lineTokenizer;
-		textio::Tokenizer::TokenList m_tokens;
+		fileio::Compression m_compression;
+		std::unique_ptr<fileio::MappedFile> m_mappedFile;
+		// Whole input in memory (mapped file or caller buffer), read in place. nullptr when read through a stream.
+		const char* m_data;
+		std::size_t m_size;
+		std::unique_ptr<textio::LineReader> m_lineReader;
 		std::vector<ElementDefinition> m_elements;
 		CallbackMap m_readCallbackMap;
+		BatchCallbackMap m_batchReadCallbackMap;
+		ReaderMap m_readerMap;
+		ListTargetMap m_listTargetMap;
+		unsigned int m_threadCount;
+		File::DeliveryOrder m_deliveryOrder;
+		ElementIndex m_index;
+		Statistics m_statistics;
+		// Worker threads add their counters concurrently.
+		mutable std::mutex m_statisticsMutex;
 	};
 
+	inline bool isHostByteOrder(File::Format format)
+	{
+		const std::uint16_t probe = 1;
+		const bool littleEndianHost = *reinterpret_cast<const unsigned char*>(&probe) == 1;
+		return littleEndianHost ? format == File::Format::BINARY_LITTLE_ENDIAN : format == File::Format::BINARY_BIG_ENDIAN;
+	}
+
 	std::string formatString(File::Format format);
 	std::string typeString(Type type);
 }
@@ -0,0 +1,515 @@
+#include "readahead.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <windows.h>
+	#include <malloc.h>
+#else
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#include <cerrno>
+	#include <cstdlib>
+	#if defined(__linux__) && defined(__has_include)
+		#if __has_include(<linux/io_uring.h>)
+			#define LIBPLYXX_IO_URING
+			#include <linux/io_uring.h>
+			#include <sys/mman.h>
+			#include <sys/syscall.h>
+			#include <sys/uio.h>
+			#include <cstring>
+		#endif
+	#endif
+#endif
+
+namespace fileio
+{
+namespace
+{
+	const std::int64_t PENDING = std::numeric_limits<std::int64_t>::min();
+
+#ifdef _WIN32
+	typedef void* FileHandle;
+#else
+	typedef int FileHandle;
+#endif
+
+	// Blocking positional read of up to size bytes, short only at the end of the file. Negative on error.
+	std::int64_t readAt(FileHandle file, char* data, std::size_t size, std::uint64_t offset)
+	{
+		std::size_t total = 0;
+		while (total < size)
+		{
+#ifdef _WIN32
+			OVERLAPPED overlapped = {};
+			overlapped.Offset = static_cast<DWORD>(offset + total);
+			overlapped.OffsetHigh = static_cast<DWORD>((offset + total) >> 32);
+			const DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(size - total, 1u << 30));
+			DWORD count = 0;
+			if (!ReadFile(file, data + total, chunk, &count, &overlapped))
+			{
+				if (GetLastError() == ERROR_HANDLE_EOF)
+				{
+					break;
+				}
+				return -1;
+			}
+#else
+			const ssize_t count = ::pread(file, data + total, size - total, static_cast<off_t>(offset + total));
+			if (count < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return -1;
+			}
+#endif
+			if (count == 0)
+			{
+				break;
+			}
+			total += static_cast<std::size_t>(count);
+		}
+		return static_cast<std::int64_t>(total);
+	}
+}
+
+// Queue of reads, completed in any order and waited for by buffer.
+class ReadAhead::Backend
+{
+public:
+	virtual ~Backend() = default;
+	virtual void submit(std::size_t buffer, char* data, std::size_t size, std::uint64_t offset) = 0;
+	// Bytes read into the buffer by its last submitted read, negative on error.
+	virtual std::int64_t wait(std::size_t buffer) = 0;
+	virtual bool isIoUring() const { return false; };
+};
+
+namespace
+{
+	// Reads served one after the other by a worker thread.
+	class PrefetchThread : public ReadAhead::Backend
+	{
+	public:
+		PrefetchThread(FileHandle file, std::size_t bufferCount)
+			: m_file(file), m_results(bufferCount, 0), m_stop(false)
+		{
+			m_thread = std::thread([this]() { run(); });
+		}
+
+		~PrefetchThread()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_condition.notify_all();
+			m_thread.join();
+		}
+
+		virtual void submit(std::size_t buffer, char* data, std::size_t size, std::uint64_t offset) override
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_results[buffer] = PENDING;
+				m_requests.push_back(Request{ buffer, data, size, offset });
+			}
+			m_condition.notify_all();
+		}
+
+		virtual std::int64_t wait(std::size_t buffer) override
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this, buffer]() { return m_results[buffer] != PENDING; });
+			return m_results[buffer];
+		}
+
+	private:
+		struct Request
+		{
+			std::size_t buffer;
+			char* data;
+			std::size_t size;
+			std::uint64_t offset;
+		};
+
+		void run()
+		{
+			for (;;)
+			{
+				Request request;
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_condition.wait(lock, [this]() { return m_stop || !m_requests.empty(); });
+					if (m_requests.empty())
+					{
+						return;
+					}
+					request = m_requests.front();
+					m_requests.pop_front();
+				}
+				const std::int64_t result = readAt(m_file, request.data, request.size, request.offset);
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_results[request.buffer] = result;
+				}
+				m_condition.notify_all();
+			}
+		}
+
+	private:
+		FileHandle m_file;
+		std::vector<std::int64_t> m_results;
+		std::deque<Request> m_requests;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stop;
+		std::thread m_thread;
+	};
+
+#ifdef LIBPLYXX_IO_URING
+	// io_uring driven through the raw system calls, the submission and completion queues are shared memory.
+	class Ring : public ReadAhead::Backend
+	{
+	public:
+		// Null when the kernel does not provide io_uring, or forbids it.
+		static std::unique_ptr<Ring> create(int fd, std::size_t bufferCount)
+		{
+			std::unique_ptr<Ring> ring(new Ring(fd, bufferCount));
+			return ring->m_ringFd >= 0 ? std::move(ring) : nullptr;
+		}
+
+		~Ring()
+		{
+			if (m_sqes != MAP_FAILED) { ::munmap(m_sqes, m_sqesSize); }
+			if (m_cqRing != MAP_FAILED) { ::munmap(m_cqRing, m_cqRingSize); }
+			if (m_sqRing != MAP_FAILED) { ::munmap(m_sqRing, m_sqRingSize); }
+			if (m_ringFd >= 0) { ::close(m_ringFd); }
+		}
+
+		virtual void submit(std::size_t buffer, char* data, std::size_t size, std::uint64_t offset) override
+		{
+			m_iovecs[buffer].iov_base = data;
+			m_iovecs[buffer].iov_len = size;
+			m_results[buffer] = PENDING;
+
+			const unsigned int tail = *m_sqTail;
+			const unsigned int index = tail & *m_sqMask;
+			io_uring_sqe& sqe = static_cast<io_uring_sqe*>(m_sqes)[index];
+			std::memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode = IORING_OP_READV;
+			sqe.fd = m_fd;
+			sqe.off = offset;
+			sqe.addr = reinterpret_cast<std::uint64_t>(&m_iovecs[buffer]);
+			sqe.len = 1;
+			sqe.user_data = buffer;
+			m_sqArray[index] = index;
+			__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+			while (enter(1, 0, 0) < 0)
+			{
+				if (errno != EINTR && errno != EAGAIN)
+				{
+					throw std::runtime_error("Unable to read file.");
+				}
+			}
+		}
+
+		virtual std::int64_t wait(std::size_t buffer) override
+		{
+			reap();
+			while (m_results[buffer] == PENDING)
+			{
+				if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+				{
+					throw std::runtime_error("Unable to read file.");
+				}
+				reap();
+			}
+			return m_results[buffer];
+		}
+
+		virtual bool isIoUring() const override { return true; };
+
+	private:
+		Ring(int fd, std::size_t bufferCount)
+			: m_fd(fd), m_ringFd(-1), m_sqRing(MAP_FAILED), m_cqRing(MAP_FAILED), m_sqes(MAP_FAILED),
+			m_iovecs(bufferCount), m_results(bufferCount, 0)
+		{
+			io_uring_params params;
+			std::memset(&params, 0, sizeof(params));
+			const int ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, static_cast<unsigned int>(bufferCount), &params));
+			if (ringFd < 0)
+			{
+				return;
+			}
+			m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+			m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+			m_sqRing = ::mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+			m_cqRing = ::mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+			m_sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+			if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || m_sqes == MAP_FAILED)
+			{
+				::close(ringFd);
+				return;
+			}
+			char* sq = static_cast<char*>(m_sqRing);
+			char* cq = static_cast<char*>(m_cqRing);
+			m_sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+			m_sqMask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+			m_sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+			m_cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+			m_cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+			m_cqMask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+			m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+			m_ringFd = ringFd;
+		}
+
+		int enter(unsigned int submitCount, unsigned int waitCount, unsigned int flags)
+		{
+			return static_cast<int>(::syscall(__NR_io_uring_enter, m_ringFd, submitCount, waitCount, flags, nullptr, 0));
+		}
+
+		void reap()
+		{
+			unsigned int head = *m_cqHead;
+			const unsigned int tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+			for (; head != tail; ++head)
+			{
+				const io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+				m_results[static_cast<std::size_t>(cqe.user_data)] = cqe.res;
+			}
+			__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+		}
+
+	private:
+		int m_fd;
+		int m_ringFd;
+		void* m_sqRing;
+		void* m_cqRing;
+		void* m_sqes;
+		std::size_t m_sqRingSize;
+		std::size_t m_cqRingSize;
+		std::size_t m_sqesSize;
+		unsigned int* m_sqTail;
+		unsigned int* m_sqMask;
+		unsigned int* m_sqArray;
+		unsigned int* m_cqHead;
+		unsigned int* m_cqTail;
+		unsigned int* m_cqMask;
+		io_uring_cqe* m_cqes;
+		std::vector<iovec> m_iovecs;
+		std::vector<std::int64_t> m_results;
+	};
+#endif
+}
+
+#ifdef _WIN32
+ReadAhead::ReadAhead(const std::string& filename, std::size_t chunkSize, unsigned int queueDepth, bool direct)
+	: m_handle(CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN | (direct ? FILE_FLAG_NO_BUFFERING : 0), nullptr))
+{
+	init(chunkSize, queueDepth);
+}
+
+ReadAhead::ReadAhead(const std::wstring& filename, std::size_t chunkSize, unsigned int queueDepth, bool direct)
+	: m_handle(CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_FLAG_SEQUENTIAL_SCAN | (direct ? FILE_FLAG_NO_BUFFERING : 0), nullptr))
+{
+	init(chunkSize, queueDepth);
+}
+
+void ReadAhead::init(std::size_t chunkSize, unsigned int queueDepth)
+{
+	LARGE_INTEGER size;
+	if (m_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_handle, &size))
+	{
+		if (m_handle != INVALID_HANDLE_VALUE) { CloseHandle(m_handle); }
+		throw std::runtime_error("Could not open file.");
+	}
+	m_fileSize = static_cast<std::uint64_t>(size.QuadPart);
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	m_alignment = info.dwPageSize;
+	m_queueDepth = std::max(1u, queueDepth);
+	m_chunkSize = std::max(m_alignment, (chunkSize + m_alignment - 1) / m_alignment * m_alignment);
+	m_buffers = static_cast<char*>(_aligned_malloc(2 * m_chunkSize * (m_queueDepth + 1), m_alignment));
+	if (m_buffers == nullptr)
+	{
+		CloseHandle(m_handle);
+		throw std::bad_alloc();
+	}
+	m_backend.reset(new PrefetchThread(m_handle, m_queueDepth + 1));
+	m_nextRead = 0;
+	m_nextSubmit = 0;
+	start(0);
+}
+
+ReadAhead::~ReadAhead()
+{
+	try
+	{
+		drain();
+	}
+	catch (const std::runtime_error&)
+	{
+	}
+	m_backend.reset();
+	_aligned_free(m_buffers);
+	CloseHandle(m_handle);
+}
+#else
+ReadAhead::ReadAhead(const std::string& filename, std::size_t chunkSize, unsigned int queueDepth, bool direct)
+	: m_fd(-1)
+{
+#ifdef O_DIRECT
+	if (direct)
+	{
+		// Not every file system takes O_DIRECT, buffered reads are used then.
+		m_fd = ::open(filename.c_str(), O_RDONLY | O_DIRECT);
+	}
+#endif
+	if (m_fd < 0)
+	{
+		m_fd = ::open(filename.c_str(), O_RDONLY);
+	}
+#ifdef __APPLE__
+	if (direct && m_fd >= 0)
+	{
+		::fcntl(m_fd, F_NOCACHE, 1);
+	}
+#endif
+	init(chunkSize, queueDepth);
+}
+
+void ReadAhead::init(std::size_t chunkSize, unsigned int queueDepth)
+{
+	struct stat st;
+	if (m_fd < 0 || ::fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		if (m_fd >= 0) { ::close(m_fd); }
+		throw std::runtime_error("Could not open file.");
+	}
+	m_fileSize = static_cast<std::uint64_t>(st.st_size);
+	m_alignment = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+	m_queueDepth = std::max(1u, queueDepth);
+	m_chunkSize = std::max(m_alignment, (chunkSize + m_alignment - 1) / m_alignment * m_alignment);
+	void* buffers = nullptr;
+	if (::posix_memalign(&buffers, m_alignment, 2 * m_chunkSize * (m_queueDepth + 1)) != 0)
+	{
+		::close(m_fd);
+		throw std::bad_alloc();
+	}
+	m_buffers = static_cast<char*>(buffers);
+#ifdef LIBPLYXX_IO_URING
+	m_backend = Ring::create(m_fd, m_queueDepth + 1);
+#endif
+	if (!m_backend)
+	{
+		m_backend.reset(new PrefetchThread(m_fd, m_queueDepth + 1));
+	}
+	m_nextRead = 0;
+	m_nextSubmit = 0;
+	start(0);
+}
+
+ReadAhead::~ReadAhead()
+{
+	try
+	{
+		drain();
+	}
+	catch (const std::runtime_error&)
+	{
+	}
+	m_backend.reset();
+	std::free(m_buffers);
+	::close(m_fd);
+}
+#endif
+
+bool ReadAhead::usesIoUring() const
+{
+	return m_backend->isIoUring();
+}
+
+char* ReadAhead::buffer(std::uint64_t chunk) const
+{
+	// Each buffer is a prefix followed by the chunk data, both chunk sized.
+	return m_buffers + (2 * (chunk % (m_queueDepth + 1)) + 1) * m_chunkSize;
+}
+
+void ReadAhead::drain()
+{
+	// Buffers may only be reused once the reads writing to them have completed.
+	for (; m_nextRead < m_nextSubmit; ++m_nextRead)
+	{
+		m_backend->wait(static_cast<std::size_t>(m_nextRead % (m_queueDepth + 1)));
+	}
+}
+
+void ReadAhead::start(std::uint64_t offset)
+{
+	drain();
+	offset = std::min(offset, m_fileSize);
+	// Direct I/O needs aligned offsets, the first chunk starts before the requested offset.
+	m_base = offset - offset % m_alignment;
+	m_skip = static_cast<std::size_t>(offset - m_base);
+	m_chunkCount = (m_fileSize - m_base + m_chunkSize - 1) / m_chunkSize;
+	m_nextRead = 0;
+	m_nextSubmit = 0;
+}
+
+std::size_t ReadAhead::next(char*& data)
+{
+	// The buffer of the previous chunk is free again, keep the queue full.
+	while (m_nextSubmit < m_chunkCount && m_nextSubmit < m_nextRead + m_queueDepth)
+	{
+		// Whole chunks are requested, direct I/O needs aligned sizes and the tail read is short.
+		m_backend->submit(static_cast<std::size_t>(m_nextSubmit % (m_queueDepth + 1)), buffer(m_nextSubmit),
+			m_chunkSize, m_base + m_nextSubmit * m_chunkSize);
+		++m_nextSubmit;
+	}
+	if (m_nextRead == m_chunkCount)
+	{
+		return 0;
+	}
+
+	const std::uint64_t chunk = m_nextRead++;
+	const std::uint64_t offset = m_base + chunk * m_chunkSize;
+	const std::size_t expected = static_cast<std::size_t>(std::min<std::uint64_t>(m_chunkSize, m_fileSize - offset));
+	std::int64_t count = m_backend->wait(static_cast<std::size_t>(chunk % (m_queueDepth + 1)));
+	if (count >= 0 && static_cast<std::size_t>(count) < expected)
+	{
+		// Short read, complete it in place.
+		const std::int64_t rest = readAt(
+#ifdef _WIN32
+			m_handle,
+#else
+			m_fd,
+#endif
+			buffer(chunk) + count, expected - static_cast<std::size_t>(count), offset + static_cast<std::uint64_t>(count));
+		count = rest < 0 ? rest : count + rest;
+	}
+	if (count < 0)
+	{
+		throw std::runtime_error("Unable to read file.");
+	}
+
+	const std::size_t skip = chunk == 0 ? m_skip : 0;
+	const std::size_t size = std::min(static_cast<std::size_t>(count), expected);
+	data = buffer(chunk) + skip;
+	return size > skip ? size - skip : 0;
+}
+}
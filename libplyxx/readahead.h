@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace fileio
+{
+	// Sequential reader of a regular file, keeping up to queueDepth chunk reads in flight ahead of the consumer.
+	// Reads are queued to io_uring where the kernel allows it, otherwise to a prefetch thread.
+	// Chunks are read into page aligned buffers, each preceded by prefixSize() writable bytes,
+	// where the caller may put the end of the previous chunk to get contiguous data without copying the new one.
+	// Errors throw std::runtime_error.
+	class ReadAhead
+	{
+	public:
+		static const std::size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+		static const unsigned int DEFAULT_QUEUE_DEPTH = 4;
+
+		// With direct, the page cache is bypassed (O_DIRECT) when the file system supports it.
+		explicit ReadAhead(const std::string& filename, std::size_t chunkSize = DEFAULT_CHUNK_SIZE,
+			unsigned int queueDepth = DEFAULT_QUEUE_DEPTH, bool direct = false);
+#ifdef _WIN32
+		explicit ReadAhead(const std::wstring& filename, std::size_t chunkSize = DEFAULT_CHUNK_SIZE,
+			unsigned int queueDepth = DEFAULT_QUEUE_DEPTH, bool direct = false);
+#endif
+		ReadAhead(const ReadAhead& other) = delete;
+		ReadAhead& operator=(const ReadAhead& other) = delete;
+		~ReadAhead();
+
+		// Restart reading at offset, reads in flight are dropped.
+		void start(std::uint64_t offset);
+		// Wait for the next chunk and return its size, 0 at the end of the file.
+		// The chunk stays valid until the next call to next() or start().
+		std::size_t next(char*& data);
+		std::size_t prefixSize() const { return m_chunkSize; };
+		bool usesIoUring() const;
+
+		class Backend;
+
+	private:
+		void init(std::size_t chunkSize, unsigned int queueDepth);
+		char* buffer(std::uint64_t chunk) const;
+		void drain();
+
+	private:
+#ifdef _WIN32
+		void* m_handle;
+#else
+		int m_fd;
+#endif
+		std::uint64_t m_fileSize;
+		std::size_t m_alignment;
+		std::size_t m_chunkSize;
+		unsigned int m_queueDepth;
+		char* m_buffers;
+		std::unique_ptr<Backend> m_backend;
+
+		// Chunk k starts at m_base + k * m_chunkSize and uses buffer k % (m_queueDepth + 1).
+		std::uint64_t m_base;
+		std::size_t m_skip;
+		std::uint64_t m_chunkCount;
+		std::uint64_t m_nextRead;
+		std::uint64_t m_nextSubmit;
+	};
+}
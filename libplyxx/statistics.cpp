@@ -0,0 +1,118 @@
+#include "libplyxx_internal.h"
+
+#include <chrono>
+
+#ifdef LIBPLYXX_STATISTICS
+	#ifdef _WIN32
+		#define NOMINMAX
+		#include <windows.h>
+	#else
+		#include <time.h>
+	#endif
+#endif
+
+namespace libply
+{
+Statistics emptyStatistics(const std::vector<std::string>& elementNames)
+{
+	Statistics statistics{};
+#ifdef LIBPLYXX_STATISTICS
+	statistics.enabled = true;
+#endif
+	for (const auto& name : elementNames)
+	{
+		statistics.elements.push_back(ElementStatistics{ name, 0, 0 });
+	}
+	return statistics;
+}
+
+#ifdef LIBPLYXX_STATISTICS
+namespace
+{
+	thread_local StatisticsCounters* currentCounters = nullptr;
+
+	double threadCpuTime()
+	{
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		{
+			return 0.0;
+		}
+		auto ticks = [](const FILETIME& t) { return (static_cast<std::uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime; };
+		// 100 ns units.
+		return static_cast<double>(ticks(kernel) + ticks(user)) * 1.0e-7;
+#else
+		timespec t;
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) != 0)
+		{
+			return 0.0;
+		}
+		return static_cast<double>(t.tv_sec) + static_cast<double>(t.tv_nsec) * 1.0e-9;
+#endif
+	}
+
+	void addPhase(PhaseTime& total, const PhaseTime& time)
+	{
+		total.wall += time.wall;
+		total.cpu += time.cpu;
+	}
+}
+
+StatisticsCounters* threadStatistics()
+{
+	return currentCounters;
+}
+
+void setThreadStatistics(StatisticsCounters* counters)
+{
+	currentCounters = counters;
+}
+
+PhaseTime phaseClock()
+{
+	const std::chrono::duration<double> wall = std::chrono::steady_clock::now().time_since_epoch();
+	return PhaseTime{ wall.count(), threadCpuTime() };
+}
+
+StatisticsScope::StatisticsScope(Statistics& statistics, std::mutex* mutex, std::uint64_t Statistics::* bytes)
+	: m_statistics(statistics), m_mutex(mutex), m_bytes(bytes), m_active(threadStatistics() == nullptr), m_counters{}
+{
+	if (m_active)
+	{
+		setThreadStatistics(&m_counters);
+		m_start = phaseClock();
+	}
+}
+
+StatisticsScope::~StatisticsScope()
+{
+	if (!m_active)
+	{
+		return;
+	}
+	const PhaseTime end = phaseClock();
+	setThreadStatistics(nullptr);
+	const PhaseTime parse{
+		end.wall - m_start.wall - m_counters.io.wall - m_counters.callback.wall,
+		end.cpu - m_start.cpu - m_counters.io.cpu - m_counters.callback.cpu };
+
+	std::unique_lock<std::mutex> lock;
+	if (m_mutex)
+	{
+		lock = std::unique_lock<std::mutex>(*m_mutex);
+	}
+	m_statistics.*m_bytes += m_counters.bytes;
+	m_statistics.chunksFetched += m_counters.chunks;
+	m_statistics.bufferAllocations += m_counters.bufferAllocations;
+	for (std::size_t i = 0; i < m_counters.elements.size() && i < m_statistics.elements.size(); ++i)
+	{
+		m_statistics.elements[i].elements += m_counters.elements[i];
+		m_statistics.elements[i].values += m_counters.values[i];
+	}
+	addPhase(m_statistics.io, m_counters.io);
+	addPhase(m_statistics.parse, parse);
+	addPhase(m_statistics.callback, m_counters.callback);
+}
+#endif
+}
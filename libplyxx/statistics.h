@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Statements collecting statistics, compiled only when the library is built with LIBPLYXX_STATISTICS.
+#ifdef LIBPLYXX_STATISTICS
+	#define LIBPLYXX_STATISTICS_ONLY(...) __VA_ARGS__
+#else
+	#define LIBPLYXX_STATISTICS_ONLY(...)
+#endif
+
+namespace libply
+{
+	// Time spent in a phase, in seconds.
+	struct PhaseTime
+	{
+		double wall;
+		double cpu;
+	};
+
+	// Work done by one thread during an operation, added to the statistics of the file when it ends.
+	struct StatisticsCounters
+	{
+		std::uint64_t bytes;
+		std::uint64_t chunks;
+		std::uint64_t bufferAllocations;
+		// Indexed by element type.
+		std::vector<std::uint64_t> elements;
+		std::vector<std::uint64_t> values;
+		PhaseTime io;
+		PhaseTime callback;
+	};
+
+#ifdef LIBPLYXX_STATISTICS
+	// Counters of the calling thread, nullptr when no operation collects statistics on it.
+	StatisticsCounters* threadStatistics();
+	void setThreadStatistics(StatisticsCounters* counters);
+	// Current wall clock and CPU time of the calling thread.
+	PhaseTime phaseClock();
+
+	inline void countBytes(std::uint64_t bytes)
+	{
+		if (StatisticsCounters* counters = threadStatistics())
+		{
+			counters->bytes += bytes;
+		}
+	}
+
+	// Bytes fetched from the file by one read or write call.
+	inline void countChunk(std::uint64_t bytes)
+	{
+		if (StatisticsCounters* counters = threadStatistics())
+		{
+			counters->bytes += bytes;
+			counters->chunks += bytes != 0;
+		}
+	}
+
+	inline void countElements(std::size_t type, std::uint64_t elements, std::uint64_t values)
+	{
+		if (StatisticsCounters* counters = threadStatistics())
+		{
+			if (counters->elements.size() <= type)
+			{
+				counters->elements.resize(type + 1, 0);
+				counters->values.resize(type + 1, 0);
+			}
+			counters->elements[type] += elements;
+			counters->values[type] += values;
+		}
+	}
+
+	inline void countBufferAllocation()
+	{
+		if (StatisticsCounters* counters = threadStatistics())
+		{
+			++counters->bufferAllocations;
+		}
+	}
+
+	// Adds the duration of its scope to a phase of the counters of the calling thread.
+	class PhaseTimer
+	{
+	public:
+		explicit PhaseTimer(PhaseTime StatisticsCounters::* phase)
+			: m_counters(threadStatistics()), m_phase(phase)
+		{
+			if (m_counters)
+			{
+				m_start = phaseClock();
+			}
+		};
+		PhaseTimer(const PhaseTimer& other) = delete;
+		PhaseTimer& operator=(const PhaseTimer& other) = delete;
+		~PhaseTimer()
+		{
+			if (m_counters)
+			{
+				const PhaseTime end = phaseClock();
+				(m_counters->*m_phase).wall += end.wall - m_start.wall;
+				(m_counters->*m_phase).cpu += end.cpu - m_start.cpu;
+			}
+		};
+
+	private:
+		StatisticsCounters* m_counters;
+		PhaseTime StatisticsCounters::* m_phase;
+		PhaseTime m_start;
+	};
+#endif
+}
@@ -0,0 +1,257 @@
+#include "structural.h"
+#include "cpu.h"
+
+#include <cstring>
+
+#ifdef LIBPLYXX_X86
+	#include <immintrin.h>
+#endif
+
+namespace textio
+{
+namespace
+{
+	inline unsigned int popCount(std::uint64_t bits)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<unsigned int>(__builtin_popcountll(bits));
+#else
+		unsigned int count = 0;
+		for (; bits != 0; bits &= bits - 1)
+		{
+			++count;
+		}
+		return count;
+#endif
+	}
+
+	inline std::uint64_t broadcast(char value)
+	{
+		return 0x0101010101010101ULL * static_cast<unsigned char>(value);
+	}
+
+	// One bit per byte of word equal to the byte of pattern, in memory order.
+	inline std::uint64_t matchWord(std::uint64_t word, std::uint64_t pattern)
+	{
+		const std::uint64_t x = word ^ pattern;
+		// High bit set in the bytes of x that are zero, without borrows between bytes.
+		const std::uint64_t zero = ~(((x & 0x7f7f7f7f7f7f7f7fULL) + 0x7f7f7f7f7f7f7f7fULL) | x) & 0x8080808080808080ULL;
+		// Gather the eight high bits in the top byte.
+		return (zero * 0x0002040810204081ULL) >> 56;
+	}
+
+	inline std::uint64_t loadWord(const char* data)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, data, sizeof(word));
+		return word;
+	}
+
+	void classifySWAR(const char* data, std::size_t blockCount, char delimiter, std::uint64_t* newlines, std::uint64_t* delimiters)
+	{
+		const std::uint64_t newlinePattern = broadcast('\n');
+		const std::uint64_t delimiterPattern = broadcast(delimiter);
+		for (std::size_t b = 0; b < blockCount; ++b, data += STRUCTURAL_BLOCK_SIZE)
+		{
+			std::uint64_t n = 0;
+			std::uint64_t d = 0;
+			for (unsigned int w = 0; w < 8; ++w)
+			{
+				const std::uint64_t word = loadWord(data + 8 * w);
+				n |= matchWord(word, newlinePattern) << (8 * w);
+				d |= matchWord(word, delimiterPattern) << (8 * w);
+			}
+			newlines[b] = n;
+			delimiters[b] = d;
+		}
+	}
+
+	const char* findSWAR(const char* begin, const char* end, char value)
+	{
+		const std::uint64_t pattern = broadcast(value);
+		for (; end - begin >= 8; begin += 8)
+		{
+			const std::uint64_t match = matchWord(loadWord(begin), pattern);
+			if (match != 0)
+			{
+				return begin + trailingZeros(match);
+			}
+		}
+		for (; begin != end; ++begin)
+		{
+			if (*begin == value) return begin;
+		}
+		return end;
+	}
+
+	std::size_t countSWAR(const char* begin, const char* end, char value)
+	{
+		const std::uint64_t pattern = broadcast(value);
+		std::size_t count = 0;
+		for (; end - begin >= 8; begin += 8)
+		{
+			count += popCount(matchWord(loadWord(begin), pattern));
+		}
+		for (; begin != end; ++begin)
+		{
+			count += *begin == value;
+		}
+		return count;
+	}
+
+#ifdef LIBPLYXX_X86
+	LIBPLYXX_TARGET("sse4.2")
+	inline std::uint64_t match64SSE(const char* data, __m128i pattern)
+	{
+		std::uint64_t mask = 0;
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * i));
+			mask |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, pattern)))) << (16 * i);
+		}
+		return mask;
+	}
+
+	LIBPLYXX_TARGET("sse4.2")
+	void classifySSE(const char* data, std::size_t blockCount, char delimiter, std::uint64_t* newlines, std::uint64_t* delimiters)
+	{
+		const __m128i newlinePattern = _mm_set1_epi8('\n');
+		const __m128i delimiterPattern = _mm_set1_epi8(delimiter);
+		for (std::size_t b = 0; b < blockCount; ++b, data += STRUCTURAL_BLOCK_SIZE)
+		{
+			newlines[b] = match64SSE(data, newlinePattern);
+			delimiters[b] = match64SSE(data, delimiterPattern);
+		}
+	}
+
+	LIBPLYXX_TARGET("sse4.2")
+	const char* findSSE(const char* begin, const char* end, char value)
+	{
+		const __m128i pattern = _mm_set1_epi8(value);
+		for (; end - begin >= 16; begin += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+			const unsigned int match = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, pattern)));
+			if (match != 0)
+			{
+				return begin + trailingZeros(match);
+			}
+		}
+		return findSWAR(begin, end, value);
+	}
+
+	LIBPLYXX_TARGET("sse4.2")
+	std::size_t countSSE(const char* begin, const char* end, char value)
+	{
+		const __m128i pattern = _mm_set1_epi8(value);
+		std::size_t count = 0;
+		for (; end - begin >= 64; begin += 64)
+		{
+			count += popCount(match64SSE(begin, pattern));
+		}
+		return count + countSWAR(begin, end, value);
+	}
+
+	LIBPLYXX_TARGET("avx2")
+	inline std::uint64_t match64AVX2(const char* data, __m256i pattern)
+	{
+		const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+		const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+		const std::uint64_t lowMask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, pattern)));
+		const std::uint64_t highMask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, pattern)));
+		return lowMask | (highMask << 32);
+	}
+
+	LIBPLYXX_TARGET("avx2")
+	void classifyAVX2(const char* data, std::size_t blockCount, char delimiter, std::uint64_t* newlines, std::uint64_t* delimiters)
+	{
+		const __m256i newlinePattern = _mm256_set1_epi8('\n');
+		const __m256i delimiterPattern = _mm256_set1_epi8(delimiter);
+		for (std::size_t b = 0; b < blockCount; ++b, data += STRUCTURAL_BLOCK_SIZE)
+		{
+			newlines[b] = match64AVX2(data, newlinePattern);
+			delimiters[b] = match64AVX2(data, delimiterPattern);
+		}
+	}
+
+	LIBPLYXX_TARGET("avx2")
+	const char* findAVX2(const char* begin, const char* end, char value)
+	{
+		const __m256i pattern = _mm256_set1_epi8(value);
+		for (; end - begin >= 32; begin += 32)
+		{
+			const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+			const unsigned int match = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, pattern)));
+			if (match != 0)
+			{
+				return begin + trailingZeros(match);
+			}
+		}
+		return findSWAR(begin, end, value);
+	}
+
+	LIBPLYXX_TARGET("avx2")
+	std::size_t countAVX2(const char* begin, const char* end, char value)
+	{
+		const __m256i pattern = _mm256_set1_epi8(value);
+		std::size_t count = 0;
+		for (; end - begin >= 64; begin += 64)
+		{
+			count += popCount(match64AVX2(begin, pattern));
+		}
+		return count + countSWAR(begin, end, value);
+	}
+#endif
+
+	struct Scanner
+	{
+		void(*classify)(const char*, std::size_t, char, std::uint64_t*, std::uint64_t*);
+		const char*(*find)(const char*, const char*, char);
+		std::size_t(*count)(const char*, const char*, char);
+	};
+
+	Scanner selectScanner()
+	{
+#ifdef LIBPLYXX_X86
+		if (libply::cpuFeatures().avx2)
+		{
+			return Scanner{ classifyAVX2, findAVX2, countAVX2 };
+		}
+		if (libply::cpuFeatures().sse42)
+		{
+			return Scanner{ classifySSE, findSSE, countSSE };
+		}
+#endif
+		return Scanner{ classifySWAR, findSWAR, countSWAR };
+	}
+
+	const Scanner& scanner()
+	{
+		static const Scanner selected = selectScanner();
+		return selected;
+	}
+}
+
+void classifyBlocks(const char* data, std::size_t blockCount, char delimiter, std::uint64_t* newlines, std::uint64_t* delimiters)
+{
+	scanner().classify(data, blockCount, delimiter, newlines, delimiters);
+}
+
+void classifyTail(const char* data, std::size_t size, char delimiter, std::uint64_t& newlines, std::uint64_t& delimiters)
+{
+	// Zero padding never matches, the delimiter of a text format is printable.
+	char block[STRUCTURAL_BLOCK_SIZE] = {};
+	std::memcpy(block, data, size);
+	scanner().classify(block, 1, delimiter, &newlines, &delimiters);
+}
+
+const char* findByte(const char* begin, const char* end, char value)
+{
+	return scanner().find(begin, end, value);
+}
+
+std::size_t countByte(const char* begin, const char* end, char value)
+{
+	return scanner().count(begin, end, value);
+}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
+namespace textio
+{
+	// Structural characters of ASCII PLY data are the line and token delimiters.
+	// Scanning uses AVX2, SSE4.2 or 64-bit SWAR words, whichever the running CPU supports.
+
+	const std::size_t STRUCTURAL_BLOCK_SIZE = 64;
+
+	// Classify blockCount blocks of 64 bytes: bit i of newlines[b] (resp. delimiters[b]) is set
+	// when byte 64 * b + i is a newline (resp. the delimiter).
+	void classifyBlocks(const char* data, std::size_t blockCount, char delimiter, std::uint64_t* newlines, std::uint64_t* delimiters);
+	// Same for the size < 64 last bytes of a text, the bits past size are cleared.
+	void classifyTail(const char* data, std::size_t size, char delimiter, std::uint64_t& newlines, std::uint64_t& delimiters);
+
+	// First occurrence of value in [begin, end), or end.
+	const char* findByte(const char* begin, const char* end, char value);
+	std::size_t countByte(const char* begin, const char* end, char value);
+
+	inline unsigned int trailingZeros(std::uint64_t bits)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<unsigned int>(__builtin_ctzll(bits));
+#elif defined(_MSC_VER) && defined(_M_X64)
+		unsigned long index;
+		_BitScanForward64(&index, bits);
+		return static_cast<unsigned int>(index);
+#else
+		unsigned int count = 0;
+		for (; (bits & 1) == 0; bits >>= 1)
+		{
+			++count;
+		}
+		return count;
+#endif
+	}
+}
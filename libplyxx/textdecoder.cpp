@@ -0,0 +1,220 @@
+#include "textdecoder.h"
+#include "libplyxx_internal.h"
+
+#include <cstring>
+
+namespace libply
+{
+namespace
+{
+	// Integers wrap around like their binary counterparts, as textio::stoi() does.
+	// Characters following the number in the token [p, end) are ignored.
+	template<typename T>
+	inline void parseToken(const char* p, const char* end, T& value)
+	{
+		typedef typename std::make_unsigned<T>::type Unsigned;
+		const bool negative = *p == '-';
+		if (negative || *p == '+')
+		{
+			++p;
+		}
+		Unsigned integer = 0;
+		for (; p != end && static_cast<unsigned char>(*p - '0') < 10; ++p)
+		{
+			integer = static_cast<Unsigned>(integer * 10 + static_cast<Unsigned>(*p - '0'));
+		}
+		value = static_cast<T>(negative ? static_cast<Unsigned>(0 - integer) : integer);
+	}
+
+	inline void parseToken(const char* p, const char* end, float& value)
+	{
+		textio::parseReal(p, end, value);
+	}
+
+	inline void parseToken(const char* p, const char* end, double& value)
+	{
+		textio::parseReal(p, end, value);
+	}
+
+	// The next token of the line.
+	template<typename T>
+	inline void decodeToken(textio::TokenScanner& scanner, T& value)
+	{
+		const char* tokenEnd;
+		const char* token = scanner.token(tokenEnd);
+		parseToken(token, tokenEnd, value);
+	}
+
+	// count values of successive properties, the k-th stored at values[k] + index * sizeof(T).
+	template<typename T>
+	void decodeRun(textio::TokenScanner& scanner, char* const* values, std::size_t index, std::size_t count)
+	{
+		for (std::size_t k = 0; k < count; ++k)
+		{
+			T value;
+			decodeToken(scanner, value);
+			std::memcpy(values[k] + index * sizeof(T), &value, sizeof(T));
+		}
+	}
+
+	void decodeRun(Type type, textio::TokenScanner& scanner, char* const* values, std::size_t index, std::size_t count)
+	{
+		switch (type)
+		{
+		case Type::CHAR: decodeRun<signed char>(scanner, values, index, count); return;
+		case Type::UCHAR: decodeRun<unsigned char>(scanner, values, index, count); return;
+		case Type::SHORT: decodeRun<short>(scanner, values, index, count); return;
+		case Type::USHORT: decodeRun<unsigned short>(scanner, values, index, count); return;
+		case Type::INT: decodeRun<int>(scanner, values, index, count); return;
+		case Type::UINT: decodeRun<unsigned int>(scanner, values, index, count); return;
+		case Type::FLOAT: decodeRun<float>(scanner, values, index, count); return;
+		case Type::DOUBLE: decodeRun<double>(scanner, values, index, count); return;
+		}
+		throw std::logic_error("Unknown type.");
+	}
+
+	// count values stored contiguously from values.
+	template<typename T>
+	void decodeArray(textio::TokenScanner& scanner, char* values, std::size_t count)
+	{
+		for (std::size_t k = 0; k < count; ++k)
+		{
+			T value;
+			decodeToken(scanner, value);
+			std::memcpy(values + k * sizeof(T), &value, sizeof(T));
+		}
+	}
+
+	void decodeArray(Type type, textio::TokenScanner& scanner, char* values, std::size_t count)
+	{
+		switch (type)
+		{
+		case Type::CHAR: decodeArray<signed char>(scanner, values, count); return;
+		case Type::UCHAR: decodeArray<unsigned char>(scanner, values, count); return;
+		case Type::SHORT: decodeArray<short>(scanner, values, count); return;
+		case Type::USHORT: decodeArray<unsigned short>(scanner, values, count); return;
+		case Type::INT: decodeArray<int>(scanner, values, count); return;
+		case Type::UINT: decodeArray<unsigned int>(scanner, values, count); return;
+		case Type::FLOAT: decodeArray<float>(scanner, values, count); return;
+		case Type::DOUBLE: decodeArray<double>(scanner, values, count); return;
+		}
+		throw std::logic_error("Unknown type.");
+	}
+
+	void skipTokens(textio::TokenScanner& scanner, std::size_t count)
+	{
+		const char* tokenEnd;
+		for (std::size_t k = 0; k < count; ++k)
+		{
+			scanner.token(tokenEnd);
+		}
+	}
+
+	std::size_t parseListLength(textio::TokenScanner& scanner)
+	{
+		long long value;
+		decodeToken(scanner, value);
+		if (value < 0)
+		{
+			throw std::runtime_error("Invalid list length.");
+		}
+		return static_cast<std::size_t>(value);
+	}
+}
+
+TextDecoder::TextDecoder(const ElementDefinition& definition)
+	: TextDecoder()
+{
+	const auto& properties = definition.properties;
+	m_isList = !properties.empty() && properties.front().isList;
+	if (m_isList)
+	{
+		m_listType = properties.front().type;
+		return;
+	}
+	for (const auto& p : properties)
+	{
+		if (!m_runs.empty() && m_runs.back().type == p.type && m_runs.back().selected == p.selected)
+		{
+			++m_runs.back().count;
+		}
+		else
+		{
+			m_runs.push_back(Run{ p.type, 1, p.selected });
+		}
+		if (p.selected)
+		{
+			m_values.push_back(nullptr);
+		}
+	}
+}
+
+void TextDecoder::decodeScalars(textio::TokenScanner& scanner, std::size_t index) const
+{
+	char* const* values = m_values.data();
+	for (const auto& run : m_runs)
+	{
+		if (run.selected)
+		{
+			decodeRun(run.type, scanner, values, index, run.count);
+			values += run.count;
+		}
+		else
+		{
+			skipTokens(scanner, run.count);
+		}
+	}
+	scanner.nextLine();
+}
+
+const char* TextDecoder::decode(const char* begin, const char* end, std::size_t count, ElementBatch& batch)
+{
+	textio::TokenScanner scanner(begin, end, ' ');
+	if (m_isList)
+	{
+		while (batch.size() < count && scanner.position() != end)
+		{
+			const std::size_t length = parseListLength(scanner);
+			decodeArray(m_listType, scanner, batch.appendList(length), length);
+			scanner.nextLine();
+		}
+		return scanner.position();
+	}
+	for (std::size_t j = 0; j < m_values.size(); ++j)
+	{
+		m_values[j] = batch.value(j, 0);
+	}
+	std::size_t index = batch.size();
+	for (; index < count && scanner.position() != end; ++index)
+	{
+		decodeScalars(scanner, index);
+	}
+	batch.m_size = index;
+	return scanner.position();
+}
+
+const char* TextDecoder::decode(const char* begin, const char* end, ElementBuffer& buffer)
+{
+	textio::TokenScanner scanner(begin, end, ' ');
+	if (m_isList)
+	{
+		const std::size_t length = parseListLength(scanner);
+		buffer.reset(length);
+		if (length != 0)
+		{
+			decodeArray(m_listType, scanner, buffer.data(0), length);
+		}
+	}
+	else
+	{
+		for (std::size_t j = 0; j < m_values.size(); ++j)
+		{
+			m_values[j] = buffer.data(j);
+		}
+		decodeScalars(scanner, 0);
+		return scanner.position();
+	}
+	scanner.nextLine();
+	return scanner.position();
+}
+}
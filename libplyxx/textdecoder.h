@@ -0,0 +1,42 @@
+#pragma once
+
+#include "libplyxx.h"
+
+namespace libply
+{
+	// Decodes ASCII elements straight from the text into the typed storage of batches and buffers, without tokenizing the lines.
+	// Tokens and line ends are located with textio::TokenScanner, from the bitmasks of the structural characters.
+	// Consecutive properties of the same type form a run, decoded by a loop specialized for that type:
+	// a line costs one type dispatch per run, values are converted inline.
+	// Characters following a number in its token are ignored, a line missing values throws std::runtime_error.
+	class TextDecoder
+	{
+	public:
+		TextDecoder() : m_isList(false), m_listType(Type::UCHAR) {};
+		explicit TextDecoder(const ElementDefinition& definition);
+
+		// Decode the lines of [begin, end) until the batch holds count elements or the text is exhausted.
+		// The last line may lack its newline. Returns the start of the first line not decoded.
+		const char* decode(const char* begin, const char* end, std::size_t count, ElementBatch& batch);
+		// Decode the first line of the non empty text [begin, end), returns the start of the next line.
+		const char* decode(const char* begin, const char* end, ElementBuffer& buffer);
+
+	private:
+		struct Run
+		{
+			Type type;
+			std::size_t count;
+			bool selected;
+		};
+
+		// Decode the values of the current line of scanner, then move to the next line.
+		void decodeScalars(textio::TokenScanner& scanner, std::size_t index) const;
+
+	private:
+		bool m_isList;
+		Type m_listType;
+		std::vector<Run> m_runs;
+		// Storage of the selected values of the element at index 0, one per property.
+		std::vector<char*> m_values;
+	};
+}
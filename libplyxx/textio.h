@@ -7,18 +7,30 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include "inputstream.h"
+#include "floatparse.h"
+#include "readahead.h"
+#include "statistics.h"
+#include "structural.h"
 
 namespace textio
 {
 	class SubString
 	{
 	public:
-		typedef std::string::const_iterator const_iterator;
+		typedef const char* const_iterator;
 
 	public:
 		SubString() = default;
-		SubString(const std::string::const_iterator& begin, const std::string::const_iterator& end)
+		SubString(const_iterator begin, const_iterator end)
 			: m_begin(begin), m_end(end) {};
+		SubString(const std::string& str)
+			: m_begin(str.data()), m_end(str.data() + str.size()) {};
 
 		operator std::string() const { return std::string(m_begin, m_end); };
 
@@ -45,22 +57,88 @@ namespace textio
 		char m_delimiter;
 	};
 
+	// Walks the tokens and lines of a text from the bitmasks of its newlines and delimiters, classified a block
+	// of 64 bytes at a time, each structural character being consumed once with a bit scan.
+	// Runs of delimiters separate two tokens, tokens are never empty.
+	class TokenScanner
+	{
+	public:
+		inline TokenScanner(const char* begin, const char* end, char delimiter);
+
+		// Next token of the current line, up to the newline or delimiter following it (or the end of the text).
+		// Throws std::runtime_error when the line holds no more token.
+		inline const char* token(const char*& tokenEnd);
+		// Move to the start of the next line, false if the text is exhausted.
+		inline bool nextLine();
+		// Start of the line following the last one completed, or of the next token.
+		const char* position() const { return m_position; };
+
+	private:
+		// Move to the next block, classifying the next window when the current one is done.
+		inline bool nextBlock();
+		// Next structural character at or after the position, not consumed, or the end of the text.
+		inline const char* nextStructural();
+
+	private:
+		static const std::size_t WINDOW_BLOCKS = 64;
+
+		const char* m_end;
+		char m_delimiter;
+		const char* m_position;
+
+		const char* m_window;
+		std::size_t m_windowBlocks;
+		// Windows start at one block and double, a scanner over a single line classifies little past it.
+		std::size_t m_nextWindowBlocks;
+		std::size_t m_block;
+		const char* m_blockBegin;
+		// Structural characters of the current block, not consumed yet.
+		std::uint64_t m_bits;
+		std::uint64_t m_newlines[WINDOW_BLOCKS];
+		std::uint64_t m_delimiters[WINDOW_BLOCKS];
+	};
+
 	class LineReader
 	{
 	public:
+		static const std::size_t DEFAULT_BUFFER_SIZE = 1 * 1024 * 1024;
+
+		// Read a file by chunks of bufferSize bytes, the buffer grows for longer lines.
 		template<typename PathString>
-		inline LineReader(const PathString& filename, bool textMode = false);
+		inline LineReader(const PathString& filename, bool textMode = false, std::size_t bufferSize = DEFAULT_BUFFER_SIZE);
+		// Read in place from a memory buffer (e.g. a mapped file), without copying.
+		// The buffer must outlive the reader.
+		inline LineReader(const char* data, std::size_t size);
+		// Read through asynchronous read-ahead, starting at offset.
+		inline LineReader(std::unique_ptr<fileio::ReadAhead> readAhead, std::streamsize offset);
+		// Read the bytes decoded by an input stream (e.g. a decompressor), seeking backwards rewinds it.
+		inline explicit LineReader(std::unique_ptr<fileio::InputStream> input);
 
 		// Read next line from input file.
-		// Returned SubString is valid until the next call to getline()
+		// Returned SubString is valid until the next call to getline() or peek()
 		inline SubString getline();
+		// The whole lines available without reading, at least one unless the input is exhausted,
+		// to be consumed with skip(). Valid until the next call to getline(), lines() or peek().
+		inline SubString lines();
+		// Move past count lines without looking at their content.
+		inline void skipLines(std::size_t count);
 		inline bool eof() const { return m_eof; };
-		inline std::ifstream& filestream() { return m_file; };
-		inline std::streamsize position(const std::string::const_iterator& workbuf_iter);
+		inline std::streamsize position(SubString::const_iterator workbuf_iter) const;
+
+		// Binary access to the input, continuing after the last line read.
+		// peek() returns a pointer to the next count bytes, or nullptr if the input ends before.
+		// skip() moves past bytes previously returned by peek().
+		inline const char* peek(std::size_t count);
+		inline void skip(std::size_t count) { m_begin += count; };
+
+		// Offset in the input of the next byte to read, and random access to it.
+		inline std::streamsize tell() const { return position(m_begin); };
+		inline void seek(std::streamsize offset);
 
 	private:
-		//inline void readFileChunk(std::streamoff offset = 0);
-		inline std::streamsize readFileChunk(std::size_t overlap);
+		inline std::streamsize readFileChunk(std::size_t required);
+		inline std::streamsize readAheadChunk(std::size_t required);
+		inline bool fill(std::size_t count);
 		inline SubString findLine();
 
 	private:
@@ -68,75 +146,31 @@ namespace textio
 
 	private:
 		std::ifstream m_file;
+		std::unique_ptr<fileio::ReadAhead> m_readAhead;
+		std::unique_ptr<fileio::InputStream> m_input;
+		bool m_inPlace;
 
-		std::streamsize m_workBufSize;
 		std::streamsize m_workBufFileEndPosition;
 		WorkBuffer m_workBuf;
 		bool m_eof;
 
-		WorkBuffer::const_iterator m_begin;
-		WorkBuffer::const_iterator m_end;
+		const char* m_begin;
+		const char* m_end;
 	};
 
-	// Convert string to floating point (real) type.
+	// Convert string to floating point (real) type, correctly rounded.
 	template<typename T>
 	T stor(const SubString& substr)
 	{
-		auto p = substr.begin();
-		auto end = substr.end();
-		T real = 0.0;
-		bool negative = false;
-		if (p != end && *p == '-')
-		{
-			negative = true;
-			++p;
-		}
-		while (p != end && *p >= '0' && *p <= '9')
-		{
-			real = (real*static_cast<T>(10.0)) + (*p - '0');
-			++p;
-		}
-		if (p != end && *p == '.')
-		{
-			T frac = 0.0;
-			int n = 0;
-			++p;
-			while (p != end && *p >= '0' && *p <= '9')
-			{
-				frac = (frac*static_cast<T>(10.0)) + (*p - '0');
-				++p;
-				++n;
-			}
-			real += frac / std::pow(static_cast<T>(10.0), n);
-		}
-		if (p != end && (*p == 'e' || *p == 'E'))
-		{
-			++p;
-			T sign = 1.0;
-			if (p != end && *p == '-')
-			{
-				sign = -1.0;
-				++p;
-			}
-			T exponent = 0.0;
-			while (p != end && *p >= '0' && *p <= '9')
-			{
-				exponent = (exponent*static_cast<T>(10.0)) + (*p - '0');
-				++p;
-			}
-			real = real * std::pow(static_cast<T>(10.0), sign * exponent);
-		}
-		if (negative)
-		{
-			real = -real;
-		}
+		T real;
+		parseReal(substr.begin(), substr.end(), real);
 		return real;
 	}
 
 	template<typename T>
 	T stor(const std::string& str)
 	{
-		return stor<T>(SubString(str.cbegin(), str.cend()));
+		return stor<T>(SubString(str));
 	}
 
 	// Convert string to unsigned type.
@@ -184,7 +218,7 @@ namespace textio
 	template<typename T>
 	T stou(const std::string& str)
 	{
-		return stou<T>(SubString(str.cbegin(), str.cend()));
+		return stou<T>(SubString(str));
 	}
 
 	Tokenizer::Tokenizer(char delimiter)
@@ -202,7 +236,7 @@ namespace textio
 
 	Tokenizer::TokenList Tokenizer::tokenize(const std::string& buffer) const
 	{
-		return tokenize(SubString(buffer.cbegin(), buffer.cend()));
+		return tokenize(SubString(buffer));
 	}
 
 	inline textio::SubString::const_iterator find(textio::SubString::const_iterator begin, textio::SubString::const_iterator end, char delimiter)
@@ -216,38 +250,32 @@ namespace textio
 		return end;
 	}
 
+	// Vectorized search, see findByte().
 	inline textio::SubString::const_iterator findSIMD(textio::SubString::const_iterator begin, textio::SubString::const_iterator end, char delimiter)
 	{
-		uint64_t pattern;
-		switch (delimiter)
-		{
-			case '\n': pattern = 0x0a0a0a0a0a0a0a0aULL; break;
-			case ' ': pattern = 0x2020202020202020ULL; break;
-			default: throw std::runtime_error("Unsupported delimiter.");
-		}
+		return findByte(begin, end, delimiter);
+	}
 
-		auto start = begin;
-		const size_t WORD_WIDTH = 8;
-		while (end - start > WORD_WIDTH)
-		{
-			// Xor data with pattern to find the bit distance. Matching bytes will be 0x00, otherwise >0x00.
-			// When subtracting 0x01 to all bytes, only bytes at 0x00 will underflow to 0xff, i.e. bytes that match the pattern.
-			// Apply bitwise-and between that last result and 0x80, i.e. b10000000, to keep bytes >0x80. Since the last ASCII character is 0x79, only the matching bytes that underflowed are kept.
-			// Must also test with ~data, because subtraction at 0x00 cause borrowing from the adjacent byte, which might have cause an underflow at that byte.
-			uint64_t data = *(uint64_t*)&(*start);
-			data = data ^ pattern;
-			if ((data - 0x0101010101010101ULL) & ~data & 0x8080808080808080)
-			{
-				// Delimiter found in sequence.
-				return textio::find(start, end, delimiter);
-			}
-			else
+	// Count the occurrences of delimiter.
+	inline std::size_t count(textio::SubString::const_iterator begin, textio::SubString::const_iterator end, char delimiter)
+	{
+		return countByte(begin, end, delimiter);
+	}
+
+	// Move past up to count newline terminated lines, count is decreased by the number of lines skipped.
+	inline textio::SubString::const_iterator skipLines(textio::SubString::const_iterator begin, textio::SubString::const_iterator end, std::size_t& count)
+	{
+		while (count != 0)
+		{
+			const auto eol = findSIMD(begin, end, '\n');
+			if (eol == end)
 			{
-				start += WORD_WIDTH;
+				break;
 			}
+			begin = eol + 1;
+			--count;
 		}
-		// Remaining data in sequence too small to run SIMD search.
-		return textio::find(begin, end, delimiter);
+		return begin;
 	}
 
 	inline void Tokenizer::tokenize(const SubString& buffer, TokenList& tokens) const
@@ -274,9 +302,106 @@ namespace textio
 		}
 	}
 
+	TokenScanner::TokenScanner(const char* begin, const char* end, char delimiter)
+		: m_end(end), m_delimiter(delimiter), m_position(begin),
+		m_window(begin), m_windowBlocks(0), m_nextWindowBlocks(1), m_block(0), m_blockBegin(begin), m_bits(0)
+	{
+	}
+
+	bool TokenScanner::nextBlock()
+	{
+		if (++m_block >= m_windowBlocks)
+		{
+			const std::size_t classified = m_windowBlocks * STRUCTURAL_BLOCK_SIZE;
+			if (classified >= static_cast<std::size_t>(m_end - m_window))
+			{
+				return false;
+			}
+			m_window += classified;
+			std::size_t blocks = (m_end - m_window) / STRUCTURAL_BLOCK_SIZE;
+			if (blocks > m_nextWindowBlocks)
+			{
+				blocks = m_nextWindowBlocks;
+			}
+			if (blocks == 0)
+			{
+				classifyTail(m_window, m_end - m_window, m_delimiter, m_newlines[0], m_delimiters[0]);
+				m_windowBlocks = 1;
+			}
+			else
+			{
+				classifyBlocks(m_window, blocks, m_delimiter, m_newlines, m_delimiters);
+				m_windowBlocks = blocks;
+			}
+			if (m_nextWindowBlocks < WINDOW_BLOCKS)
+			{
+				m_nextWindowBlocks *= 2;
+			}
+			m_block = 0;
+		}
+		m_blockBegin = m_window + m_block * STRUCTURAL_BLOCK_SIZE;
+		m_bits = m_newlines[m_block] | m_delimiters[m_block];
+		return true;
+	}
+
+	const char* TokenScanner::nextStructural()
+	{
+		while (m_bits == 0)
+		{
+			if (!nextBlock())
+			{
+				return m_end;
+			}
+		}
+		return m_blockBegin + trailingZeros(m_bits);
+	}
+
+	const char* TokenScanner::token(const char*& tokenEnd)
+	{
+		const char* structural = nextStructural();
+		// Delimiters before the token.
+		while (structural == m_position)
+		{
+			// The end of the text is no structural character, it ends a last line without newline.
+			if (structural == m_end || *structural == '\n')
+			{
+				throw std::runtime_error("Missing value in element line.");
+			}
+			m_bits &= m_bits - 1;
+			++m_position;
+			structural = nextStructural();
+		}
+		if (m_position == m_end || *m_position == '\r')
+		{
+			throw std::runtime_error("Missing value in element line.");
+		}
+		const char* begin = m_position;
+		tokenEnd = m_position = structural;
+		return begin;
+	}
+
+	bool TokenScanner::nextLine()
+	{
+		for (;;)
+		{
+			const char* structural = nextStructural();
+			if (structural == m_end)
+			{
+				m_position = m_end;
+				return false;
+			}
+			m_bits &= m_bits - 1;
+			m_position = structural + 1;
+			if (*structural == '\n')
+			{
+				return m_position != m_end;
+			}
+		}
+	}
+
 	template<typename PathString>
-	LineReader::LineReader(const PathString& filename, bool textMode)
-		: m_workBufSize(1 * 1024 * 1024), m_eof(false), m_workBufFileEndPosition(0)
+	LineReader::LineReader(const PathString& filename, bool textMode, std::size_t bufferSize)
+		: m_inPlace(false), m_workBufFileEndPosition(0), m_eof(false)
 	{
 		std::ios_base::openmode mode = std::fstream::in;
 		if (!textMode) { mode |= std::fstream::binary; }
@@ -285,7 +410,30 @@ namespace textio
 		{
 			throw std::runtime_error("Could not open file.");
 		}
-		m_workBuf.resize(m_workBufSize);
+		m_workBuf.resize(bufferSize);
+		m_begin = m_end = m_workBuf.data();
+		readFileChunk(0);
+	}
+
+	LineReader::LineReader(const char* data, std::size_t size)
+		: m_inPlace(true), m_workBufFileEndPosition(size), m_eof(false),
+		m_begin(data), m_end(data + size)
+	{
+	}
+
+	LineReader::LineReader(std::unique_ptr<fileio::ReadAhead> readAhead, std::streamsize offset)
+		: m_readAhead(std::move(readAhead)), m_inPlace(false), m_workBufFileEndPosition(offset), m_eof(false)
+	{
+		m_begin = m_end = m_workBuf.data();
+		m_readAhead->start(offset);
+		readFileChunk(0);
+	}
+
+	LineReader::LineReader(std::unique_ptr<fileio::InputStream> input)
+		: m_input(std::move(input)), m_inPlace(false), m_workBufFileEndPosition(0), m_eof(false)
+	{
+		m_workBuf.resize(DEFAULT_BUFFER_SIZE);
+		m_begin = m_end = m_workBuf.data();
 		readFileChunk(0);
 	}
 
@@ -294,54 +442,242 @@ namespace textio
 		return findLine();
 	}
 
-	std::streamsize LineReader::readFileChunk(std::size_t overlap)
+	SubString LineReader::lines()
 	{
-		char* bufferFront = &m_workBuf.front();
-		if (overlap != 0)
+		// The last newline is usually close to the end of the buffer.
+		const char* last = m_end;
+		while (last != m_begin && *(last - 1) != '\n')
+		{
+			--last;
+		}
+		while (last == m_begin)
 		{
-			size_t offset = m_workBufSize - overlap;
-			std::memcpy(bufferFront, bufferFront + offset, overlap);
+			const std::size_t scanned = m_end - m_begin;
+			if (!fill(scanned + 1))
+			{
+				m_eof = true;
+				return SubString(m_begin, m_end);
+			}
+			last = m_end;
+			while (last != m_begin + scanned && *(last - 1) != '\n')
+			{
+				--last;
+			}
+			if (last == m_begin + scanned)
+			{
+				last = m_begin;
+			}
 		}
-		m_file.read(bufferFront + overlap, m_workBufSize - overlap);
-		m_begin = m_workBuf.cbegin();
-		m_end = m_workBuf.cbegin() + overlap + m_file.gcount();
-		m_workBufFileEndPosition += m_file.gcount();
-		return m_file.gcount();
+		return SubString(m_begin, last);
 	}
 
-	SubString LineReader::findLine()
+	void LineReader::skipLines(std::size_t count)
 	{
-		SubString::const_iterator eol = findSIMD(m_begin, m_end, '\n');
-		if (m_begin == m_workBuf.cbegin() && eol == m_end)
+		m_begin = textio::skipLines(m_begin, m_end, count);
+		while (count != 0)
 		{
-			std::runtime_error("Working buffer too small to fit single line.");
+			// The work buffer ends in the middle of a line.
+			if (!fill(m_end - m_begin + 1))
+			{
+				m_eof = true;
+				m_begin = m_end;
+				return;
+			}
+			m_begin = textio::skipLines(m_begin, m_end, count);
 		}
-		SubString lineSubstring(m_begin, eol);
+	}
 
-		// Reached the end of the work buffer (last character not a newline delimiter).
-		if (eol == m_end)
+	const char* LineReader::peek(std::size_t count)
+	{
+		if (static_cast<std::size_t>(m_end - m_begin) < count && !fill(count))
 		{
-			auto count = readFileChunk(m_end - m_begin);
-			if (count == 0 && m_file.eof())
+			return nullptr;
+		}
+		return m_begin;
+	}
+
+	void LineReader::seek(std::streamsize offset)
+	{
+		if (offset == tell())
+		{
+			return;
+		}
+		m_eof = false;
+		if (m_inPlace)
+		{
+			// m_end stays at the end of the buffer, which holds the whole input.
+			const char* data = m_end - m_workBufFileEndPosition;
+			m_begin = data + std::min(offset, m_workBufFileEndPosition);
+			return;
+		}
+		if (offset > tell() && offset <= m_workBufFileEndPosition)
+		{
+			m_begin += offset - tell();
+			return;
+		}
+		if (m_readAhead)
+		{
+			m_readAhead->start(offset);
+			m_begin = m_end = m_workBuf.data();
+			m_workBufFileEndPosition = offset;
+			readFileChunk(0);
+			return;
+		}
+		if (m_input)
+		{
+			if (offset < tell())
 			{
-				m_eof = true;
-				return SubString(m_begin, m_end);
+				m_input->rewind();
+				m_begin = m_end = m_workBuf.data();
+				m_workBufFileEndPosition = 0;
+			}
+		}
+		else
+		{
+			m_file.clear();
+			m_file.seekg(offset);
+			if (m_file)
+			{
+				m_begin = m_end = m_workBuf.data();
+				m_workBufFileEndPosition = offset;
+				readFileChunk(0);
+				return;
+			}
+
+			// Not seekable (e.g. a pipe), move forward by reading.
+			m_file.clear();
+			if (offset < tell())
+			{
+				throw std::runtime_error("Could not seek in file.");
+			}
+		}
+		while (m_workBufFileEndPosition < offset)
+		{
+			m_begin = m_end;
+			if (readFileChunk(0) == 0)
+			{
+				return;
+			}
+		}
+		m_begin = m_end - (m_workBufFileEndPosition - offset);
+	}
+
+	std::streamsize LineReader::readFileChunk(std::size_t required)
+	{
+		if (m_readAhead)
+		{
+			return readAheadChunk(required);
+		}
+
+		// Move the unconsumed data to the front of the work buffer, growing it if too small.
+		const std::size_t overlap = m_end - m_begin;
+		const std::size_t offset = m_begin - m_workBuf.data();
+		if (required > m_workBuf.size())
+		{
+			m_workBuf.resize(std::max(required, 2 * m_workBuf.size()));
+		}
+		char* bufferFront = &m_workBuf.front();
+		if (overlap != 0 && offset != 0)
+		{
+			std::memmove(bufferFront, bufferFront + offset, overlap);
+		}
+		std::streamsize count;
+		{
+			LIBPLYXX_STATISTICS_ONLY(libply::PhaseTimer timer(&libply::StatisticsCounters::io);)
+			if (m_input)
+			{
+				count = static_cast<std::streamsize>(m_input->read(bufferFront + overlap, m_workBuf.size() - overlap));
 			}
 			else
 			{
-				lineSubstring = findLine();
+				m_file.read(bufferFront + overlap, m_workBuf.size() - overlap);
+				count = m_file.gcount();
 			}
 		}
-		// Line complete.
+		LIBPLYXX_STATISTICS_ONLY(libply::countChunk(count);)
+		m_begin = bufferFront;
+		m_end = bufferFront + overlap + count;
+		m_workBufFileEndPosition += count;
+		return count;
+	}
+
+	std::streamsize LineReader::readAheadChunk(std::size_t required)
+	{
+		// Keep the unconsumed data aside, next() recycles the chunk holding it.
+		const std::size_t overlap = m_end - m_begin;
+		if (m_workBuf.size() < overlap)
+		{
+			m_workBuf.resize(overlap);
+		}
+		std::memmove(&m_workBuf[0], m_begin, overlap);
+
+		char* chunk = nullptr;
+		std::size_t count;
+		{
+			// Only the time spent waiting for the reading thread counts as I/O.
+			LIBPLYXX_STATISTICS_ONLY(libply::PhaseTimer timer(&libply::StatisticsCounters::io);)
+			count = m_readAhead->next(chunk);
+		}
+		LIBPLYXX_STATISTICS_ONLY(libply::countChunk(count);)
+		m_workBufFileEndPosition += count;
+		if (count != 0 && overlap <= m_readAhead->prefixSize() && overlap + count >= required)
+		{
+			// Usual case, the overlap goes in front of the chunk, which is used in place.
+			std::memcpy(chunk - overlap, m_workBuf.data(), overlap);
+			m_begin = chunk - overlap;
+			m_end = chunk + count;
+		}
 		else
 		{
-			// Set begin pointer to the first character after the newline delimiter.
-			m_begin = eol + 1;
+			// Gather in the work buffer what does not fit before the chunk.
+			if (m_workBuf.size() < overlap + count)
+			{
+				m_workBuf.resize(std::max(overlap + count, 2 * m_workBuf.size()));
+			}
+			std::memcpy(&m_workBuf[overlap], chunk, count);
+			m_begin = m_workBuf.data();
+			m_end = m_begin + overlap + count;
 		}
+		return count;
+	}
+
+	bool LineReader::fill(std::size_t count)
+	{
+		while (static_cast<std::size_t>(m_end - m_begin) < count)
+		{
+			if (m_inPlace || readFileChunk(count) == 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	SubString LineReader::findLine()
+	{
+		SubString::const_iterator eol = findSIMD(m_begin, m_end, '\n');
+		while (eol == m_end)
+		{
+			// Reached the end of the work buffer (last character not a newline delimiter).
+			const std::size_t scanned = m_end - m_begin;
+			if (!fill(scanned + 1))
+			{
+				m_eof = true;
+				SubString lineSubstring(m_begin, m_end);
+				m_begin = m_end;
+				return lineSubstring;
+			}
+			eol = findSIMD(m_begin + scanned, m_end, '\n');
+		}
+
+		// Line complete.
+		SubString lineSubstring(m_begin, eol);
+		// Set begin pointer to the first character after the newline delimiter.
+		m_begin = eol + 1;
 		return lineSubstring;
 	}
 
-	std::streamsize LineReader::position(const std::string::const_iterator& workbuf_iter)
+	std::streamsize LineReader::position(SubString::const_iterator workbuf_iter) const
 	{
 		return m_workBufFileEndPosition - (m_end - workbuf_iter);
 	}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libply
+{
+	// Fixed set of worker threads running tasks in submission order.
+	class ThreadPool
+	{
+	public:
+		inline explicit ThreadPool(unsigned int threadCount);
+		ThreadPool(const ThreadPool& other) = delete;
+		ThreadPool& operator=(const ThreadPool& other) = delete;
+		inline ~ThreadPool();
+
+		inline std::future<void> submit(std::function<void()> task);
+		unsigned int size() const { return static_cast<unsigned int>(m_threads.size()); };
+
+	private:
+		inline void run();
+
+	private:
+		std::vector<std::thread> m_threads;
+		std::deque<std::packaged_task<void()>> m_tasks;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_stop;
+	};
+
+	// Wait for every future, then rethrow the first exception raised by a task.
+	inline void waitAll(std::deque<std::future<void>>& futures)
+	{
+		std::exception_ptr error;
+		for (auto& f : futures)
+		{
+			try
+			{
+				f.get();
+			}
+			catch (...)
+			{
+				if (!error) { error = std::current_exception(); }
+			}
+		}
+		futures.clear();
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+
+	ThreadPool::ThreadPool(unsigned int threadCount)
+		: m_stop(false)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = 1;
+		}
+		for (unsigned int i = 0; i < threadCount; ++i)
+		{
+			m_threads.emplace_back([this]() { run(); });
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_condition.notify_all();
+		for (auto& t : m_threads)
+		{
+			t.join();
+		}
+	}
+
+	std::future<void> ThreadPool::submit(std::function<void()> task)
+	{
+		std::packaged_task<void()> packagedTask(std::move(task));
+		std::future<void> future = packagedTask.get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back(std::move(packagedTask));
+		}
+		m_condition.notify_one();
+		return future;
+	}
+
+	void ThreadPool::run()
+	{
+		for (;;)
+		{
+			std::packaged_task<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+				// Pending tasks are still run when stopping, their futures would otherwise never be ready.
+				if (m_tasks.empty())
+				{
+					return;
+				}
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+}
@@ -1,11 +1,15 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 
 #include "libplyxx.h"
 
 bool areClose(double a, double b)
 {
-	const double EPSILON = 1.0e-1;
-	return abs(a - b) < EPSILON;
+	const double EPSILON = 1.0e-4;
+	return std::abs(a - b) < EPSILON;
 }
 
 struct Vertex
@@ -29,9 +33,9 @@ struct Mesh
 	TriangleIndicesList triangles;
 };
 
-void readply(PATH_STRING filename, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles)
+void readply(libply::File& file, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles, unsigned int threadCount = 1)
 {
-	libply::File file(filename);
+	file.setThreadCount(threadCount);
 	const auto& definitions = file.definitions();
 
 	const auto vertexDefinition = definitions.at(0);
@@ -55,10 +59,251 @@ void readply(PATH_STRING filename, Mesh::VertexList& vertices, Mesh::TriangleInd
 	file.read();
 }
 
-void writeply(PATH_STRING filename, const libply::ElementsDefinition& definitions, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles, libply::File::Format format)
+void readply(PATH_STRING filename, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles, unsigned int threadCount = 1)
+{
+	libply::File file(filename);
+	readply(file, vertices, triangles, threadCount);
+}
+
+// Stream buffer over a string that cannot seek, like a pipe.
+class ForwardBuffer : public std::streambuf
+{
+public:
+	explicit ForwardBuffer(std::string& data)
+	{
+		setg(&data[0], &data[0], &data[0] + data.size());
+	}
+};
+
+// Read only the element types given a list, the other ones are skipped.
+void readply_partial(PATH_STRING filename, Mesh::VertexList* vertices, Mesh::TriangleIndicesList* triangles, unsigned int threadCount = 1)
+{
+	libply::File file(filename);
+	file.setThreadCount(threadCount);
+	libply::ElementReadCallback vertexCallback = [vertices](libply::ElementBuffer& e)
+	{
+		vertices->emplace_back(e[0], e[1], e[2]);
+	};
+	libply::ElementReadCallback triangleCallback = [triangles](libply::ElementBuffer& e)
+	{
+		triangles->emplace_back(std::move(Mesh::TriangleIndices{ e[0], e[1], e[2] }));
+	};
+	if (vertices)
+	{
+		file.setElementReadCallback("vertex", vertexCallback);
+	}
+	if (triangles)
+	{
+		file.setElementReadCallback("face", triangleCallback);
+	}
+	file.read();
+}
+
+// Pull vertices and faces alternately, one batch of each at a time.
+void readply_cursor(PATH_STRING filename, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles)
+{
+	libply::File file(filename);
+	auto vertexCursor = file.cursor("vertex", 1000);
+	auto faceCursor = file.cursor("face", 700);
+	libply::ElementBatch vertexBatch, faceBatch;
+	bool moreVertices = true, moreFaces = true;
+	while (moreVertices || moreFaces)
+	{
+		moreVertices = moreVertices && vertexCursor.next(vertexBatch);
+		if (moreVertices)
+		{
+			const auto x = vertexBatch.column<float>(0);
+			const auto y = vertexBatch.column<float>(1);
+			const auto z = vertexBatch.column<float>(2);
+			for (size_t i = 0; i < vertexBatch.size(); ++i)
+			{
+				vertices.emplace_back(x[i], y[i], z[i]);
+			}
+		}
+		moreFaces = moreFaces && faceCursor.next(faceBatch);
+		if (moreFaces)
+		{
+			const auto offsets = faceBatch.listOffsets();
+			const auto indices = faceBatch.column<int>(0);
+			for (size_t i = 0; i < faceBatch.size(); ++i)
+			{
+				const auto t = offsets[i];
+				triangles.push_back(Mesh::TriangleIndices{ Mesh::VertexIndex(indices[t]), Mesh::VertexIndex(indices[t + 1]), Mesh::VertexIndex(indices[t + 2]) });
+			}
+		}
+	}
+}
+
+void readply_range(PATH_STRING filename, size_t first, size_t count, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles,
+	size_t interval, bool sidecar = false)
+{
+	libply::File file(filename);
+	file.buildIndex(interval, sidecar);
+
+	libply::ElementReadCallback vertexCallback = [&vertices](libply::ElementBuffer& e)
+	{
+		vertices.emplace_back(e[0], e[1], e[2]);
+	};
+	libply::ElementReadCallback triangleCallback = [&triangles](libply::ElementBuffer& e)
+	{
+		triangles.emplace_back(std::move(Mesh::TriangleIndices{ e[0], e[1], e[2] }));
+	};
+	file.readRange("face", first, count, triangleCallback);
+	file.readRange("vertex", first, count, vertexCallback);
+}
+
+void readply_readahead(PATH_STRING filename, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles, size_t chunkSize, bool direct)
+{
+	libply::File file(filename);
+	file.setReadAhead(chunkSize, 3, direct);
+	libply::ElementReadCallback vertexCallback = [&vertices](libply::ElementBuffer& e)
+	{
+		vertices.emplace_back(e[0], e[1], e[2]);
+	};
+	libply::ElementReadCallback triangleCallback = [&triangles](libply::ElementBuffer& e)
+	{
+		triangles.emplace_back(std::move(Mesh::TriangleIndices{ e[0], e[1], e[2] }));
+	};
+	file.setElementReadCallback("vertex", vertexCallback);
+	file.setElementReadCallback("face", triangleCallback);
+	file.read();
+}
+
+void readply_batch(PATH_STRING filename, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles)
+{
+	libply::File file(filename);
+
+	libply::ElementBatchReadCallback vertexCallback = [&vertices](libply::ElementBatch& b)
+	{
+		const auto x = b.column<float>(0);
+		const auto y = b.column<float>(1);
+		const auto z = b.column<float>(2);
+		for (size_t i = 0; i < b.size(); ++i)
+		{
+			vertices.emplace_back(x[i], y[i], z[i]);
+		}
+	};
+
+	libply::ElementBatchReadCallback triangleCallback = [&triangles](libply::ElementBatch& b)
+	{
+		const auto indices = b.column<int>(0);
+		const auto offsets = b.listOffsets();
+		for (size_t i = 0; i < b.size(); ++i)
+		{
+			const auto t = offsets[i];
+			triangles.push_back(Mesh::TriangleIndices{ Mesh::VertexIndex(indices[t]), Mesh::VertexIndex(indices[t + 1]), Mesh::VertexIndex(indices[t + 2]) });
+		}
+	};
+
+	file.setElementBatchReadCallback("vertex", vertexCallback, 1000);
+	file.setElementBatchReadCallback("face", triangleCallback, 1000);
+	file.read();
+}
+
+struct PackedVertex
+{
+	float x, y, z;
+};
+
+struct WideVertex
+{
+	int tag;
+	double z, y, x;
+};
+
+void readply_struct(PATH_STRING filename, Mesh::VertexList& vertices, unsigned int threadCount = 1, libply::File::DeliveryOrder order = libply::File::DeliveryOrder::FILE_ORDER)
+{
+	std::vector<PackedVertex> packed;
+	std::vector<WideVertex> wide;
+	{
+		libply::File file(filename);
+		file.setThreadCount(threadCount);
+		file.setDeliveryOrder(order);
+		file.setElementReadTarget("vertex", libply::bind<PackedVertex>(&PackedVertex::x, "x", &PackedVertex::y, "y", &PackedVertex::z, "z"), packed);
+		libply::ElementReadCallback skipFaces = [](libply::ElementBuffer&) {};
+		file.setElementReadCallback("face", skipFaces);
+		file.read();
+	}
+	{
+		libply::File file(filename);
+		file.setThreadCount(threadCount);
+		file.setDeliveryOrder(order);
+		file.setElementReadTarget("vertex", libply::bind<WideVertex>(&WideVertex::x, "x", &WideVertex::y, "y", &WideVertex::z, "z"), wide);
+		libply::ElementReadCallback skipFaces = [](libply::ElementBuffer&) {};
+		file.setElementReadCallback("face", skipFaces);
+		file.read();
+	}
+	for (size_t i = 0; i < packed.size() && i < wide.size(); ++i)
+	{
+		if (packed[i].x != wide[i].x || packed[i].y != wide[i].y || packed[i].z != wide[i].z)
+		{
+			std::cout << "struct vertex " << i << " is different" << std::endl;
+		}
+		vertices.emplace_back(packed[i].x, packed[i].y, packed[i].z);
+	}
+}
+
+void readply_lists(PATH_STRING filename, Mesh::TriangleIndicesList& triangles, unsigned int threadCount = 1)
+{
+	libply::File file(filename);
+	libply::ListColumn faces;
+	file.setListReadTarget("face", faces);
+	file.setThreadCount(threadCount);
+	file.read();
+
+	if (faces.width() != 3 || !faces.offsets().empty())
+	{
+		std::cout << "face lists are not dense triangles" << std::endl;
+	}
+	const auto indices = faces.values<int>();
+	for (size_t i = 0; i < faces.size(); ++i)
+	{
+		const auto t = faces.offset(i);
+		triangles.push_back(Mesh::TriangleIndices{ Mesh::VertexIndex(indices[t]), Mesh::VertexIndex(indices[t + 1]), Mesh::VertexIndex(indices[t + 2]) });
+	}
+}
+
+void readply_unordered(PATH_STRING filename, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles, unsigned int threadCount)
+{
+	libply::File file(filename);
+	file.setThreadCount(threadCount);
+	file.setDeliveryOrder(libply::File::DeliveryOrder::UNORDERED);
+	const auto definitions = file.definitions();
+	vertices.assign(definitions.at(0).size, Vertex(0, 0, 0));
+	triangles.assign(definitions.at(1).size, Mesh::TriangleIndices{ 0, 0, 0 });
+
+	// Batches cover disjoint ranges, so they can be stored without locking.
+	libply::ElementBatchReadCallback vertexCallback = [&vertices](libply::ElementBatch& b)
+	{
+		const auto x = b.column<float>(0);
+		const auto y = b.column<float>(1);
+		const auto z = b.column<float>(2);
+		for (size_t i = 0; i < b.size(); ++i)
+		{
+			vertices[b.firstIndex() + i] = Vertex(x[i], y[i], z[i]);
+		}
+	};
+	libply::ElementBatchReadCallback triangleCallback = [&triangles](libply::ElementBatch& b)
+	{
+		const auto indices = b.column<int>(0);
+		const auto offsets = b.listOffsets();
+		for (size_t i = 0; i < b.size(); ++i)
+		{
+			const auto t = offsets[i];
+			triangles[b.firstIndex() + i] = Mesh::TriangleIndices{ Mesh::VertexIndex(indices[t]), Mesh::VertexIndex(indices[t + 1]), Mesh::VertexIndex(indices[t + 2]) };
+		}
+	};
+
+	file.setElementBatchReadCallback("vertex", vertexCallback, 100);
+	file.setElementBatchReadCallback("face", triangleCallback, 100);
+	file.read();
+}
+
+void writeply(PATH_STRING filename, const libply::ElementsDefinition& definitions, Mesh::VertexList& vertices, Mesh::TriangleIndicesList& triangles, libply::File::Format format, int decimals = -1)
 {
 	libply::FileOut file(filename, format);
 	file.setElementsDefinition(definitions);
+	file.setRealPrecision(decimals);
 	
 	libply::ElementWriteCallback vertexCallback = [&vertices](libply::ElementBuffer& e, size_t index)
 		{
@@ -81,6 +326,167 @@ void writeply(PATH_STRING filename, const libply::ElementsDefinition& definition
 	file.write();
 }
 
+struct TypedSample
+{
+	signed char c;
+	unsigned char uc;
+	short s;
+	unsigned short us;
+	int i;
+	unsigned int ui;
+	float f;
+	double d;
+
+	bool operator==(const TypedSample& o) const
+	{
+		return c == o.c && uc == o.uc && s == o.s && us == o.us && i == o.i && ui == o.ui && f == o.f && d == o.d;
+	}
+};
+
+void readply_types(PATH_STRING filename, std::vector<TypedSample>& samples)
+{
+	libply::File file(filename);
+	libply::ElementBatchReadCallback sampleCallback = [&samples](libply::ElementBatch& b)
+	{
+		// Every column keeps the width of its PLY type.
+		const auto c = b.column<signed char>(0);
+		const auto uc = b.column<unsigned char>(1);
+		const auto s = b.column<short>(2);
+		const auto us = b.column<unsigned short>(3);
+		const auto i = b.column<int>(4);
+		const auto ui = b.column<unsigned int>(5);
+		const auto f = b.column<float>(6);
+		const auto d = b.column<double>(7);
+		for (size_t k = 0; k < b.size(); ++k)
+		{
+			samples.push_back(TypedSample{ c[k], uc[k], s[k], us[k], i[k], ui[k], f[k], d[k] });
+		}
+	};
+	file.setElementBatchReadCallback("sample", sampleCallback);
+	file.read();
+}
+
+// Read only uc, i and d, through both batches and element buffers, the other members are left at zero.
+void readply_types_projected(PATH_STRING filename, std::vector<TypedSample>& batchSamples, std::vector<TypedSample>& elementSamples)
+{
+	libply::File file(filename);
+	file.select("sample", { "d", "uc", "i" });
+	libply::ElementBatchReadCallback batchCallback = [&batchSamples](libply::ElementBatch& b)
+	{
+		const auto uc = b.column<unsigned char>(0);
+		const auto i = b.column<int>(1);
+		const auto d = b.column<double>(2);
+		for (size_t k = 0; k < b.size(); ++k)
+		{
+			batchSamples.push_back(TypedSample{ 0, uc[k], 0, 0, i[k], 0, 0, d[k] });
+		}
+	};
+	file.setElementBatchReadCallback("sample", batchCallback);
+	file.read();
+
+	libply::ElementReadCallback elementCallback = [&elementSamples](libply::ElementBuffer& e)
+	{
+		elementSamples.push_back(TypedSample{ 0, static_cast<unsigned char>(static_cast<unsigned int>(e[0])), 0, 0, e[1], 0, 0, e[2] });
+	};
+	file.setElementReadCallback("sample", elementCallback);
+	file.read();
+}
+
+void writeply_types(PATH_STRING filename, const libply::ElementsDefinition& definitions, const std::vector<TypedSample>& samples, libply::File::Format format)
+{
+	libply::FileOut file(filename, format);
+	file.setElementsDefinition(definitions);
+	// A buffer smaller than one element, flushed for every value.
+	file.setBufferSize(4);
+	file.setPreallocate(true);
+	libply::ElementWriteCallback sampleCallback = [&samples](libply::ElementBuffer& e, size_t index)
+	{
+		const auto& s = samples[index];
+		e[0] = s.c;
+		e[1] = s.uc;
+		e[2] = s.s;
+		e[3] = s.us;
+		e[4] = s.i;
+		e[5] = s.ui;
+		e[6] = s.f;
+		e[7] = s.d;
+	};
+	file.setElementWriteCallback("sample", sampleCallback);
+	file.write();
+}
+
+// Mixed type sizes written by blocks of rows.
+void writeply_types_arrays(PATH_STRING filename, const libply::ElementsDefinition& definitions, const std::vector<TypedSample>& samples, libply::File::Format format)
+{
+	libply::FileOut file(filename, format);
+	file.setElementsDefinition(definitions);
+	const std::size_t stride = sizeof(TypedSample);
+	file.setElementArrays("sample", {
+		libply::propertyArray(&samples[0].c, stride), libply::propertyArray(&samples[0].uc, stride),
+		libply::propertyArray(&samples[0].s, stride), libply::propertyArray(&samples[0].us, stride),
+		libply::propertyArray(&samples[0].i, stride), libply::propertyArray(&samples[0].ui, stride),
+		libply::propertyArray(&samples[0].f, stride), libply::propertyArray(&samples[0].d, stride) });
+	file.write();
+}
+
+// ASCII data with runs of spaces, CRLF line ends and a last line without newline.
+void writeply_irregular(PATH_STRING filename)
+{
+	std::ofstream file(filename, std::ios::binary);
+	file << "ply\nformat ascii 1.0\n"
+		<< "element vertex 2\nproperty float x\nproperty float y\nproperty float z\n"
+		<< "element face 2\nproperty list uchar int vertex_indices\nend_header\n"
+		<< "  1.5   -2 3e1 \r\n0.25 4 -0.5\r\n"
+		<< "3  0 1   1\r\n3 1 0 0";
+}
+
+// Faces of 3, 3, 4, 3 and 0 vertices, the fourth one at vertex 6.
+void writeply_mixed_lists(PATH_STRING filename)
+{
+	std::ofstream file(filename, std::ios::binary);
+	file << "ply\nformat binary_little_endian 1.0\n"
+		<< "element face 5\nproperty list uchar int vertex_indices\nend_header\n";
+	const std::vector<std::vector<int>> faces = { { 0, 1, 2 }, { 2, 1, 3 }, { 3, 4, 5, 6 }, { 6, 5, 7 }, {} };
+	for (const auto& face : faces)
+	{
+		file.put(static_cast<char>(face.size()));
+		for (int index : face)
+		{
+			const char bytes[4] = { static_cast<char>(index), 0, 0, 0 };
+			file.write(bytes, 4);
+		}
+	}
+}
+
+bool compare_samples(const std::vector<TypedSample>& left, const std::vector<TypedSample>& right)
+{
+	if (left != right)
+	{
+		std::cout << "typed samples are different" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void writeply_arrays(PATH_STRING filename, const libply::ElementsDefinition& definitions, const std::vector<PackedVertex>& vertices, const Mesh::TriangleIndicesList& triangles, libply::File::Format format)
+{
+	libply::FileOut file(filename, format);
+	file.setElementsDefinition(definitions);
+
+	// Vertices as an array of structs, faces as CSR offsets into the contiguous indices.
+	std::vector<unsigned int> offsets;
+	for (size_t i = 0; i <= triangles.size(); ++i)
+	{
+		offsets.push_back(static_cast<unsigned int>(3 * i));
+	}
+	file.setElementArrays("vertex", {
+		libply::propertyArray(&vertices[0].x, sizeof(PackedVertex)),
+		libply::propertyArray(&vertices[0].y, sizeof(PackedVertex)),
+		libply::propertyArray(&vertices[0].z, sizeof(PackedVertex)) });
+	file.setElementArrays("face", { libply::listArray(offsets.data(), triangles[0].data()) });
+	file.write();
+}
+
 bool compare_vertices(const Mesh::VertexList& left, const Mesh::VertexList& right)
 {
 	if (left.size() != right.size())
@@ -101,6 +507,28 @@ bool compare_vertices(const Mesh::VertexList& left, const Mesh::VertexList& righ
 	return errors == 0;
 }
 
+bool compare_vertices_exact(const Mesh::VertexList& left, const Mesh::VertexList& right, double tolerance = 0.0)
+{
+	if (left.size() != right.size())
+	{
+		std::cout << "Length mismatch" << std::endl;
+		return false;
+	}
+
+	int errors = 0;
+	for (unsigned int i = 0; i < left.size(); ++i)
+	{
+		const auto& l = left[i];
+		const auto& r = right[i];
+		if (std::abs(l.x - r.x) > tolerance || std::abs(l.y - r.y) > tolerance || std::abs(l.z - r.z) > tolerance)
+		{
+			std::cout << "vertex " << i << " is different" << std::endl;
+			++errors;
+		}
+	}
+	return errors == 0;
+}
+
 bool compare_triangles(const Mesh::TriangleIndicesList& left, const Mesh::TriangleIndicesList& right)
 {
 	if (left.size() != right.size())
@@ -121,6 +549,71 @@ bool compare_triangles(const Mesh::TriangleIndicesList& left, const Mesh::Triang
 	return errors == 0;
 }
 
+bool compare_definitions(const libply::ElementsDefinition& left, const libply::ElementsDefinition& right)
+{
+	bool equal = left.size() == right.size();
+	for (std::size_t e = 0; equal && e < left.size(); ++e)
+	{
+		equal = left[e].name == right[e].name && left[e].size == right[e].size && left[e].properties.size() == right[e].properties.size();
+		for (std::size_t p = 0; equal && p < left[e].properties.size(); ++p)
+		{
+			const auto& l = left[e].properties[p];
+			const auto& r = right[e].properties[p];
+			equal = l.name == r.name && l.type == r.type && l.isList == r.isList;
+		}
+	}
+	if (!equal)
+	{
+		std::cout << "Definitions mismatch" << std::endl;
+	}
+	return equal;
+}
+
+// Statistics count every element with its values when collected, and nothing otherwise.
+bool check_statistics(const libply::Statistics& statistics, const std::vector<libply::Element>& definitions, std::uint64_t vertexValues, std::uint64_t faceValues)
+{
+	bool valid = statistics.elements.size() == definitions.size();
+	for (std::size_t e = 0; valid && e < definitions.size(); ++e)
+	{
+		const auto& element = statistics.elements[e];
+		const std::uint64_t values = element.name == "vertex" ? vertexValues : faceValues;
+		valid = element.name == definitions[e].name
+			&& element.elements == (statistics.enabled ? definitions[e].size : 0)
+			&& element.values == (statistics.enabled ? values : 0);
+	}
+	const std::uint64_t bytes = statistics.bytesRead + statistics.bytesWritten;
+	valid = valid && (statistics.enabled ? bytes != 0 : bytes == 0 && statistics.chunksFetched == 0);
+	if (!valid)
+	{
+		std::cout << "Statistics mismatch" << std::endl;
+	}
+	return valid;
+}
+
+// Whether reading the vertices of an ASCII PLY held in memory reports a line missing values.
+bool check_missing_value(const std::string& data, unsigned int threadCount)
+{
+	// Exactly sized, reads past the end are not hidden by a terminator.
+	const std::vector<char> buffer(data.begin(), data.end());
+	libply::File file(buffer.data(), buffer.size());
+	file.setThreadCount(threadCount);
+	libply::ElementReadCallback vertexCallback = [](libply::ElementBuffer&) {};
+	file.setElementReadCallback("vertex", vertexCallback);
+	try
+	{
+		file.read();
+	}
+	catch (const std::exception& e)
+	{
+		if (std::string(e.what()) == "Missing value in element line.")
+		{
+			return true;
+		}
+	}
+	std::cout << "missing value not reported with " << threadCount << " threads" << std::endl;
+	return false;
+}
+
 int main()
 {
 	Mesh::VertexList ascii_vertices;
@@ -134,9 +627,260 @@ int main()
 	compare_vertices(ascii_vertices, bin_vertices);
 	compare_triangles(ascii_triangles, bin_triangles);
 
+	Mesh::VertexList be_vertices;
+	Mesh::TriangleIndicesList be_triangles;
+	readply(Str("../test/data/test_bin_be.ply"), be_vertices, be_triangles);
+	compare_vertices(bin_vertices, be_vertices);
+	compare_triangles(bin_triangles, be_triangles);
+	be_vertices.clear();
+	be_triangles.clear();
+	readply_batch(Str("../test/data/test_bin_be.ply"), be_vertices, be_triangles);
+	compare_vertices(bin_vertices, be_vertices);
+	compare_triangles(bin_triangles, be_triangles);
+
+	Mesh::VertexList batch_vertices;
+	Mesh::TriangleIndicesList batch_triangles;
+	readply_batch(Str("../test/data/test.ply"), batch_vertices, batch_triangles);
+	compare_vertices(ascii_vertices, batch_vertices);
+	compare_triangles(ascii_triangles, batch_triangles);
+	batch_vertices.clear();
+	batch_triangles.clear();
+	readply_batch(Str("../test/data/test_bin.ply"), batch_vertices, batch_triangles);
+	compare_vertices(bin_vertices, batch_vertices);
+	compare_triangles(bin_triangles, batch_triangles);
+
+	Mesh::VertexList parallel_vertices;
+	Mesh::TriangleIndicesList parallel_triangles;
+	readply(Str("../test/data/test.ply"), parallel_vertices, parallel_triangles, 4);
+	compare_vertices(ascii_vertices, parallel_vertices);
+	compare_triangles(ascii_triangles, parallel_triangles);
+	parallel_vertices.clear();
+	parallel_triangles.clear();
+	readply_unordered(Str("../test/data/test.ply"), parallel_vertices, parallel_triangles, 4);
+	compare_vertices(ascii_vertices, parallel_vertices);
+	compare_triangles(ascii_triangles, parallel_triangles);
+
+	for (const auto filename : { Str("../test/data/test.ply"), Str("../test/data/test_bin.ply"), Str("../test/data/test_bin_be.ply") })
+	{
+		for (unsigned int threadCount : { 1, 4 })
+		{
+			Mesh::VertexList partial_vertices;
+			Mesh::TriangleIndicesList partial_triangles;
+			readply_partial(filename, &partial_vertices, nullptr, threadCount);
+			readply_partial(filename, nullptr, &partial_triangles, threadCount);
+			compare_vertices(ascii_vertices, partial_vertices);
+			compare_triangles(ascii_triangles, partial_triangles);
+		}
+	}
+
+	for (const auto filename : { Str("../test/data/test.ply"), Str("../test/data/test_bin.ply"), Str("../test/data/test_bin_be.ply") })
+	{
+		Mesh::VertexList cursor_vertices;
+		Mesh::TriangleIndicesList cursor_triangles;
+		readply_cursor(filename, cursor_vertices, cursor_triangles);
+		compare_vertices(ascii_vertices, cursor_vertices);
+		compare_triangles(ascii_triangles, cursor_triangles);
+	}
+
+	for (const auto filename : { Str("../test/data/test.ply"), Str("../test/data/test_bin.ply"), Str("../test/data/test_bin_be.ply") })
+	{
+		for (const bool direct : { false, true })
+		{
+			Mesh::VertexList readahead_vertices;
+			Mesh::TriangleIndicesList readahead_triangles;
+			readply_readahead(filename, readahead_vertices, readahead_triangles, 4096, direct);
+			compare_vertices(ascii_vertices, readahead_vertices);
+			compare_triangles(ascii_triangles, readahead_triangles);
+		}
+	}
+
+	// Ranges read through the index match the same elements of a full read.
+	const size_t rangeFirst = 1000, rangeCount = 2500;
+	const Mesh::VertexList range_vertices_ref(ascii_vertices.begin() + rangeFirst, ascii_vertices.begin() + rangeFirst + rangeCount);
+	const Mesh::TriangleIndicesList range_triangles_ref(ascii_triangles.begin() + rangeFirst, ascii_triangles.begin() + rangeFirst + rangeCount);
+	for (const auto filename : { Str("../test/data/test.ply"), Str("../test/data/test_bin.ply"), Str("../test/data/test_bin_be.ply") })
+	{
+		Mesh::VertexList range_vertices;
+		Mesh::TriangleIndicesList range_triangles;
+		readply_range(filename, rangeFirst, rangeCount, range_vertices, range_triangles, 64);
+		compare_vertices(range_vertices_ref, range_vertices);
+		compare_triangles(range_triangles_ref, range_triangles);
+	}
+
+	writeply_irregular(Str("../test/results/irregular.ply"));
+	const Mesh::VertexList irregular_vertices_ref = { Vertex(1.5, -2.0, 30.0), Vertex(0.25, 4.0, -0.5) };
+	const Mesh::TriangleIndicesList irregular_triangles_ref = { Mesh::TriangleIndices{ 0, 1, 1 }, Mesh::TriangleIndices{ 1, 0, 0 } };
+	Mesh::VertexList irregular_vertices;
+	Mesh::TriangleIndicesList irregular_triangles;
+	readply(Str("../test/results/irregular.ply"), irregular_vertices, irregular_triangles);
+	compare_vertices(irregular_vertices_ref, irregular_vertices);
+	compare_triangles(irregular_triangles_ref, irregular_triangles);
+	irregular_vertices.clear();
+	irregular_triangles.clear();
+	readply_batch(Str("../test/results/irregular.ply"), irregular_vertices, irregular_triangles);
+	compare_vertices(irregular_vertices_ref, irregular_vertices);
+	compare_triangles(irregular_triangles_ref, irregular_triangles);
+
+	for (const auto filename : { Str("../test/data/test.ply"), Str("../test/data/test_bin.ply") })
+	{
+		for (unsigned int threadCount : { 1, 4 })
+		{
+			libply::File file(filename);
+			libply::ElementBatchReadCallback ignore = [](libply::ElementBatch&) {};
+			file.setElementBatchReadCallback("vertex", ignore, 1000);
+			file.setElementBatchReadCallback("face", ignore, 1000);
+			file.setThreadCount(threadCount);
+			file.read();
+			check_statistics(file.statistics(), file.definitions(), 3 * ascii_vertices.size(), 3 * ascii_triangles.size());
+			file.resetStatistics();
+			if (file.statistics().bytesRead != 0 || file.statistics().elements.front().elements != 0)
+			{
+				std::cout << "Statistics not reset" << std::endl;
+			}
+		}
+	}
+
+	// Header probes match the definitions of a full open, files that cannot be read report an error.
+	const std::vector<PATH_STRING> probed = { Str("../test/data/test.ply"), Str("../test/data/test_bin_be.ply"), Str("../test/data/missing.ply"), Str("../test/data/test_types.ply") };
+	const auto probes = libply::probeHeaders(probed, 2);
+	for (std::size_t i = 0; i < probed.size(); ++i)
+	{
+		if (probes[i].filename != probed[i] || probes[i].error.empty() != (i != 2))
+		{
+			std::cout << "Probe " << i << " is different" << std::endl;
+			continue;
+		}
+		if (i != 2)
+		{
+			libply::File file(probed[i]);
+			compare_definitions(file.definitions(), probes[i].header.definitions);
+		}
+	}
+	std::ifstream probedFile(probed[1], std::ios::binary);
+	const std::string probedContent((std::istreambuf_iterator<char>(probedFile)), std::istreambuf_iterator<char>());
+	if (probes[1].header.format != libply::File::Format::BINARY_BIG_ENDIAN || probes[1].header.dataOffset != probedContent.find("end_header\n") + 11)
+	{
+		std::cout << "Probe header mismatch" << std::endl;
+	}
+
+	const std::string vertexHeader = "ply\nformat ascii 1.0\nelement vertex 2\nproperty float x\nproperty float y\nproperty float z\nend_header\n";
+	for (unsigned int threadCount : { 1, 4 })
+	{
+		check_missing_value(vertexHeader + "1 2\n4 5 6\n", threadCount);
+		// Last line without newline.
+		check_missing_value(vertexHeader + "1 2 3\n4 5", threadCount);
+		check_missing_value(vertexHeader + "1 2 3\n4 5 ", threadCount);
+	}
+
+	// Memory buffers are parsed in place, streams are read forward from the header.
+	for (const auto filename : { Str("../test/data/test.ply"), Str("../test/data/test_bin.ply"), Str("../test/data/test_bin_be.ply") })
+	{
+		std::ifstream input(filename, std::ios::binary);
+		std::string content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+		Mesh::VertexList memory_vertices;
+		Mesh::TriangleIndicesList memory_triangles;
+		libply::File memoryFile(content.data(), content.size());
+		readply(memoryFile, memory_vertices, memory_triangles, 4);
+		compare_vertices(ascii_vertices, memory_vertices);
+		compare_triangles(ascii_triangles, memory_triangles);
+
+		Mesh::VertexList stream_vertices;
+		Mesh::TriangleIndicesList stream_triangles;
+		ForwardBuffer buffer(content);
+		std::istream stream(&buffer);
+		libply::File streamFile(stream);
+		readply(streamFile, stream_vertices, stream_triangles);
+		compare_vertices(ascii_vertices, stream_vertices);
+		compare_triangles(ascii_triangles, stream_triangles);
+	}
+
+	// Compressed files read like the files they hold, seeking backwards included.
+	std::vector<PATH_STRING> compressed;
+#ifdef LIBPLYXX_ZLIB
+	compressed.push_back(Str("../test/data/test.ply.gz"));
+#endif
+#ifdef LIBPLYXX_ZSTD
+	compressed.push_back(Str("../test/data/test_bin.ply.zst"));
+#endif
+	for (const auto& filename : compressed)
+	{
+		Mesh::VertexList compressed_vertices;
+		Mesh::TriangleIndicesList compressed_triangles;
+		readply(filename, compressed_vertices, compressed_triangles, 4);
+		compare_vertices(ascii_vertices, compressed_vertices);
+		compare_triangles(ascii_triangles, compressed_triangles);
+		compressed_vertices.clear();
+		compressed_triangles.clear();
+		readply_cursor(filename, compressed_vertices, compressed_triangles);
+		compare_vertices(ascii_vertices, compressed_vertices);
+		compare_triangles(ascii_triangles, compressed_triangles);
+		compressed_vertices.clear();
+		compressed_triangles.clear();
+		readply_range(filename, rangeFirst, rangeCount, compressed_vertices, compressed_triangles, 64);
+		compare_vertices(range_vertices_ref, compressed_vertices);
+		compare_triangles(range_triangles_ref, compressed_triangles);
+	}
+
+	for (const auto filename : { Str("../test/data/test.ply"), Str("../test/data/test_bin.ply"), Str("../test/data/test_bin_be.ply") })
+	{
+		Mesh::TriangleIndicesList list_triangles;
+		readply_lists(filename, list_triangles);
+		compare_triangles(ascii_triangles, list_triangles);
+	}
+	{
+		Mesh::TriangleIndicesList list_triangles;
+		readply_lists(Str("../test/data/test.ply"), list_triangles, 4);
+		compare_triangles(ascii_triangles, list_triangles);
+	}
+	{
+		writeply_mixed_lists(Str("../test/results/mixed_lists.ply"));
+		libply::File file(Str("../test/results/mixed_lists.ply"));
+		libply::ListColumn faces;
+		file.setListReadTarget("face", faces);
+		file.read();
+		const std::vector<std::size_t> offsets = { 0, 3, 6, 10, 13, 13 };
+		const auto indices = faces.values<int>();
+		if (faces.size() != 5 || faces.width() != 0 || !std::equal(offsets.begin(), offsets.end(), faces.offsets().begin(), faces.offsets().end())
+			|| indices.size() != 13 || indices[9] != 6 || indices[12] != 7)
+		{
+			std::cout << "mixed face lists are different" << std::endl;
+		}
+	}
+	{
+		// Faces with a color, which a list column cannot hold.
+		{
+			std::ofstream out(Str("../test/results/colored_faces.ply"), std::ios::binary);
+			out << "ply\nformat ascii 1.0\n"
+				<< "element face 1\nproperty list uchar int vertex_indices\nproperty uchar red\nproperty uchar green\nproperty uchar blue\nend_header\n"
+				<< "3 0 1 2 255 0 0\n";
+		}
+		libply::File file(Str("../test/results/colored_faces.ply"));
+		libply::ListColumn faces;
+		try
+		{
+			file.setListReadTarget("face", faces);
+			std::cout << "list target accepted a face with extra properties" << std::endl;
+		}
+		catch (const std::invalid_argument&)
+		{
+		}
+	}
+
+	Mesh::VertexList struct_vertices;
+	readply_struct(Str("../test/data/test.ply"), struct_vertices);
+	compare_vertices(ascii_vertices, struct_vertices);
+	struct_vertices.clear();
+	readply_struct(Str("../test/data/test_bin.ply"), struct_vertices);
+	compare_vertices(bin_vertices, struct_vertices);
+	struct_vertices.clear();
+	readply_struct(Str("../test/data/test.ply"), struct_vertices, 4, libply::File::DeliveryOrder::UNORDERED);
+	compare_vertices(ascii_vertices, struct_vertices);
+
 	libply::File refFile(Str("../test/data/test.ply"));
 	writeply(Str("../test/results/write_ascii.ply"), refFile.definitions(), ascii_vertices, ascii_triangles, libply::File::Format::ASCII);
 	writeply(Str("../test/results/write_bin.ply"), refFile.definitions(), ascii_vertices, ascii_triangles, libply::File::Format::BINARY_LITTLE_ENDIAN);
+	writeply(Str("../test/results/write_bin_be.ply"), refFile.definitions(), ascii_vertices, ascii_triangles, libply::File::Format::BINARY_BIG_ENDIAN);
 
 	Mesh::VertexList readback_ascii_vertices;
 	Mesh::TriangleIndicesList readback_ascii_triangles;
@@ -149,5 +893,78 @@ int main()
 	readply(Str("../test/results/write_bin.ply"), readback_bin_vertices, readback_bin_triangles);
 	compare_vertices(bin_vertices, readback_bin_vertices);
 	compare_triangles(bin_triangles, readback_bin_triangles);
+
+	// Binary values written as text read back exactly, or within half a unit of the requested precision.
+	writeply(Str("../test/results/write_ascii_exact.ply"), refFile.definitions(), bin_vertices, bin_triangles, libply::File::Format::ASCII);
+	Mesh::VertexList exact_vertices;
+	Mesh::TriangleIndicesList exact_triangles;
+	readply(Str("../test/results/write_ascii_exact.ply"), exact_vertices, exact_triangles);
+	compare_vertices_exact(bin_vertices, exact_vertices);
+	writeply(Str("../test/results/write_ascii_mm.ply"), refFile.definitions(), bin_vertices, bin_triangles, libply::File::Format::ASCII, 3);
+	Mesh::VertexList mm_vertices;
+	Mesh::TriangleIndicesList mm_triangles;
+	readply(Str("../test/results/write_ascii_mm.ply"), mm_vertices, mm_triangles);
+	compare_vertices_exact(bin_vertices, mm_vertices, 0.0005 + 1.0e-6);
+
+	// The sidecar index is written by the first read and loaded by the second one.
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		Mesh::VertexList range_vertices;
+		Mesh::TriangleIndicesList range_triangles;
+		readply_range(Str("../test/results/write_bin.ply"), rangeFirst, rangeCount, range_vertices, range_triangles, 100, true);
+		compare_vertices(range_vertices_ref, range_vertices);
+		compare_triangles(range_triangles_ref, range_triangles);
+	}
+
+	Mesh::VertexList readback_be_vertices;
+	Mesh::TriangleIndicesList readback_be_triangles;
+	readply(Str("../test/results/write_bin_be.ply"), readback_be_vertices, readback_be_triangles);
+	compare_vertices(bin_vertices, readback_be_vertices);
+	compare_triangles(bin_triangles, readback_be_triangles);
+
+	std::vector<PackedVertex> packed_vertices;
+	for (const auto& v : bin_vertices)
+	{
+		packed_vertices.push_back(PackedVertex{ static_cast<float>(v.x), static_cast<float>(v.y), static_cast<float>(v.z) });
+	}
+	for (const auto format : { libply::File::Format::ASCII, libply::File::Format::BINARY_LITTLE_ENDIAN, libply::File::Format::BINARY_BIG_ENDIAN })
+	{
+		writeply_arrays(Str("../test/results/write_arrays.ply"), refFile.definitions(), packed_vertices, bin_triangles, format);
+		Mesh::VertexList arrays_vertices;
+		Mesh::TriangleIndicesList arrays_triangles;
+		readply(Str("../test/results/write_arrays.ply"), arrays_vertices, arrays_triangles);
+		compare_vertices_exact(bin_vertices, arrays_vertices);
+		compare_triangles(bin_triangles, arrays_triangles);
+	}
+
+	std::vector<TypedSample> samples;
+	readply_types(Str("../test/data/test_types.ply"), samples);
+	compare_samples(samples, std::vector<TypedSample>{
+		{ -128, 0, -32768, 0, -2147483647, 0, -1.5f, -2.25 },
+		{ 127, 255, 32767, 65535, 2147483647, 4294967295u, 3.5f, 1024.5 },
+		{ -1, 1, -2, 2, -3, 3, 0.25f, -0.5 } });
+	libply::File typesFile(Str("../test/data/test_types.ply"));
+	const libply::File::Format typeFormats[] = { libply::File::Format::ASCII, libply::File::Format::BINARY_LITTLE_ENDIAN, libply::File::Format::BINARY_BIG_ENDIAN };
+	for (const auto format : typeFormats)
+	{
+		std::vector<TypedSample> readback_samples;
+		writeply_types(Str("../test/results/write_types.ply"), typesFile.definitions(), samples, format);
+		readply_types(Str("../test/results/write_types.ply"), readback_samples);
+		compare_samples(samples, readback_samples);
+		readback_samples.clear();
+		writeply_types_arrays(Str("../test/results/write_types_arrays.ply"), typesFile.definitions(), samples, format);
+		readply_types(Str("../test/results/write_types_arrays.ply"), readback_samples);
+		compare_samples(samples, readback_samples);
+
+		std::vector<TypedSample> projected_samples;
+		for (const auto& sample : samples)
+		{
+			projected_samples.push_back(TypedSample{ 0, sample.uc, 0, 0, sample.i, 0, 0, sample.d });
+		}
+		std::vector<TypedSample> batch_samples, element_samples;
+		readply_types_projected(Str("../test/results/write_types.ply"), batch_samples, element_samples);
+		compare_samples(projected_samples, batch_samples);
+		compare_samples(projected_samples, element_samples);
+	}
 	std::cout << "Finished" << std::endl;
 }